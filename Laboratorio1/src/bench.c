@@ -0,0 +1,420 @@
+
+#define _POSIX_C_SOURCE 200809L
+#include "bench.h"
+#include "tree.h"
+#include "hashindex.h"
+#include "codec.h"
+#include "filesystem.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <stdatomic.h>
+
+#define BENCH_KEY_LEN 96
+#define BENCH_MIN_LOOKUPS 1000000
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Rutas como las que genera load_dir: mismo directorio, nombres numerados
+static char* make_keys(int num_keys) {
+    char *keys = malloc((size_t)num_keys * BENCH_KEY_LEN);
+    if (!keys) return NULL;
+    
+    for (int i = 0; i < num_keys; i++) {
+        snprintf(keys + (size_t)i * BENCH_KEY_LEN, BENCH_KEY_LEN,
+                 "/home/battlefs/datos/proyecto/archivo_%08d.dat", i);
+    }
+    
+    // Barajar para no insertar ni buscar en orden
+    srand(12345);
+    char tmp[BENCH_KEY_LEN];
+    for (int i = num_keys - 1; i > 0; i--) {
+        int j = rand() % (i + 1);
+        memcpy(tmp, keys + (size_t)i * BENCH_KEY_LEN, BENCH_KEY_LEN);
+        memcpy(keys + (size_t)i * BENCH_KEY_LEN, keys + (size_t)j * BENCH_KEY_LEN, BENCH_KEY_LEN);
+        memcpy(keys + (size_t)j * BENCH_KEY_LEN, tmp, BENCH_KEY_LEN);
+    }
+    return keys;
+}
+
+static int compare_keys(const void *a, const void *b) {
+    return strcmp(*(const char *const *)a, *(const char *const *)b);
+}
+
+#define BENCH_BUILD_RUNS 3
+
+// Inserción una a una frente a carga masiva; de cada una, la mejor de varias
+// pasadas para no medir los fallos de página de la primera
+static void bench_tree_build(const char *keys, int num_keys) {
+    const char **sorted = malloc((size_t)num_keys * sizeof(char*));
+    if (!sorted) return;
+    for (int i = 0; i < num_keys; i++) {
+        sorted[i] = keys + (size_t)i * BENCH_KEY_LEN;
+    }
+    
+    double insert_time = 0;
+    for (int run = 0; run < BENCH_BUILD_RUNS; run++) {
+        double start = now_seconds();
+        BPlusTree *tree = bplus_tree_init();
+        for (int i = 0; i < num_keys; i++) {
+            bplus_tree_insert(tree, sorted[i], (void*)sorted[i]);
+        }
+        double elapsed = now_seconds() - start;
+        bplus_tree_free(tree);
+        if (run == 0 || elapsed < insert_time) insert_time = elapsed;
+    }
+    
+    double start = now_seconds();
+    qsort(sorted, num_keys, sizeof(char*), compare_keys);
+    double sort_time = now_seconds() - start;
+    
+    double bulk_time = 0;
+    int status = 0;
+    for (int run = 0; run < BENCH_BUILD_RUNS; run++) {
+        start = now_seconds();
+        BPlusTree *tree = bplus_tree_init();
+        status |= bplus_tree_bulk_load(tree, sorted, (void *const *)sorted, num_keys);
+        double elapsed = now_seconds() - start;
+        bplus_tree_free(tree);
+        if (run == 0 || elapsed < bulk_time) bulk_time = elapsed;
+    }
+    
+    printf("Construcción: inserción %.1f ms, carga masiva %.1f ms (+%.1f ms si hay que ordenar)%s\n",
+           insert_time * 1e3, bulk_time * 1e3, sort_time * 1e3,
+           status != 0 ? "  (¡carga masiva fallida!)" : "");
+    free(sorted);
+}
+
+void bench_tree_search(int num_keys) {
+    if (num_keys <= 0) return;
+    
+    char *keys = make_keys(num_keys);
+    BPlusTree *tree = bplus_tree_init();
+    if (!keys || !tree) {
+        free(keys);
+        bplus_tree_free(tree);
+        return;
+    }
+    
+    for (int i = 0; i < num_keys; i++) {
+        bplus_tree_insert(tree, keys + (size_t)i * BENCH_KEY_LEN, keys + (size_t)i * BENCH_KEY_LEN);
+    }
+    bench_tree_build(keys, num_keys);
+    
+    static const struct {
+        BPlusSearchMode mode;
+        const char *name;
+    } modes[] = {
+        { BPLUS_SEARCH_LINEAR, "lineal" },
+        { BPLUS_SEARCH_BINARY, "binaria" },
+        { BPLUS_SEARCH_SIMD, "vectorial" },
+    };
+    
+    int rounds = (BENCH_MIN_LOOKUPS + num_keys - 1) / num_keys;
+    printf("Búsqueda en B+ tree: %d claves, orden %d, %d búsquedas por modo (%s)\n",
+           num_keys, ORDER, rounds * num_keys, bplus_tree_simd_name());
+    
+    for (size_t m = 0; m < sizeof(modes) / sizeof(modes[0]); m++) {
+        bplus_tree_set_search_mode(modes[m].mode);
+        
+        int misses = 0;
+        double start = now_seconds();
+        for (int r = 0; r < rounds; r++) {
+            for (int i = 0; i < num_keys; i++) {
+                const char *key = keys + (size_t)i * BENCH_KEY_LEN;
+                if (bplus_tree_search(tree, key) != key) misses++;
+            }
+        }
+        double elapsed = now_seconds() - start;
+        
+        printf("  %-10s %8.1f ns/búsqueda%s\n", modes[m].name,
+               elapsed * 1e9 / ((double)rounds * num_keys),
+               misses ? "  (¡claves no encontradas!)" : "");
+    }
+    
+    bplus_tree_set_search_mode(BPLUS_SEARCH_DEFAULT);
+    bplus_tree_free(tree);
+    
+    // La misma carga contra la tabla hash que acompaña al índice
+    HashIndex *hash = hash_index_init();
+    for (int i = 0; i < num_keys && hash; i++) {
+        const char *key = keys + (size_t)i * BENCH_KEY_LEN;
+        if (hash_index_put(hash, key, (void*)key) != 0) {
+            hash_index_free(hash);
+            hash = NULL;
+        }
+    }
+    if (hash) {
+        int misses = 0;
+        double start = now_seconds();
+        for (int r = 0; r < rounds; r++) {
+            for (int i = 0; i < num_keys; i++) {
+                const char *key = keys + (size_t)i * BENCH_KEY_LEN;
+                if (hash_index_get(hash, key) != key) misses++;
+            }
+        }
+        double elapsed = now_seconds() - start;
+        printf("  %-10s %8.1f ns/búsqueda%s\n", "hash",
+               elapsed * 1e9 / ((double)rounds * num_keys),
+               misses ? "  (¡claves no encontradas!)" : "");
+        hash_index_free(hash);
+    }
+    free(keys);
+}
+
+#define BENCH_CONCURRENT_SECONDS 0.5
+#define BENCH_CHURN_KEYS 1000
+
+// Estado compartido por lectores y escritor; con global != NULL todas las
+// operaciones pasan por ese mutex, como haría el índice sin latches
+typedef struct {
+    BPlusTree *tree;
+    const char *keys;
+    int num_keys;
+    pthread_mutex_t *global;
+    atomic_int stop;
+    atomic_llong lookups;
+    atomic_llong misses;
+} ConcurrentBench;
+
+typedef struct {
+    ConcurrentBench *bench;
+    unsigned seed;
+} ReaderArgs;
+
+static void* bench_reader(void *arg) {
+    ReaderArgs *args = arg;
+    ConcurrentBench *bench = args->bench;
+    unsigned seed = args->seed;
+    long long lookups = 0, misses = 0;
+    
+    while (!atomic_load_explicit(&bench->stop, memory_order_relaxed)) {
+        // Lotes de búsquedas entre consultas a la bandera de parada
+        for (int n = 0; n < 256; n++) {
+            seed = seed * 1103515245u + 12345u;
+            const char *key = bench->keys + (size_t)((seed >> 8) % bench->num_keys) * BENCH_KEY_LEN;
+            if (bench->global) pthread_mutex_lock(bench->global);
+            void *value = bplus_tree_search(bench->tree, key);
+            if (bench->global) pthread_mutex_unlock(bench->global);
+            if (value != key) misses++;
+        }
+        lookups += 256;
+    }
+    atomic_fetch_add(&bench->lookups, lookups);
+    atomic_fetch_add(&bench->misses, misses);
+    return NULL;
+}
+
+// Inserta y borra claves ajenas a las que buscan los lectores
+static void* bench_writer(void *arg) {
+    ConcurrentBench *bench = arg;
+    char key[BENCH_KEY_LEN];
+    
+    while (!atomic_load_explicit(&bench->stop, memory_order_relaxed)) {
+        for (int pass = 0; pass < 2; pass++) {
+            for (int i = 0; i < BENCH_CHURN_KEYS; i++) {
+                snprintf(key, sizeof(key), "/home/battlefs/datos/temporal/extra_%06d.tmp", i);
+                if (bench->global) pthread_mutex_lock(bench->global);
+                if (pass == 0) {
+                    bplus_tree_insert(bench->tree, key, NULL);
+                } else {
+                    bplus_tree_delete(bench->tree, key);
+                }
+                if (bench->global) pthread_mutex_unlock(bench->global);
+            }
+        }
+    }
+    return NULL;
+}
+
+static double run_concurrent(ConcurrentBench *bench, int threads, long long *misses) {
+    pthread_t writer;
+    pthread_t *readers = calloc(threads, sizeof(pthread_t));
+    ReaderArgs *args = calloc(threads, sizeof(ReaderArgs));
+    if (!readers || !args) {
+        free(readers);
+        free(args);
+        return -1;
+    }
+    
+    atomic_store(&bench->stop, 0);
+    atomic_store(&bench->lookups, 0);
+    atomic_store(&bench->misses, 0);
+    
+    int has_writer = pthread_create(&writer, NULL, bench_writer, bench) == 0;
+    int started = 0;
+    double start = now_seconds();
+    for (; started < threads; started++) {
+        args[started].bench = bench;
+        args[started].seed = 2654435761u * (started + 1);
+        if (pthread_create(&readers[started], NULL, bench_reader, &args[started]) != 0) break;
+    }
+    
+    struct timespec pause = { 0, (long)(BENCH_CONCURRENT_SECONDS * 1e9) };
+    nanosleep(&pause, NULL);
+    atomic_store(&bench->stop, 1);
+    
+    for (int i = 0; i < started; i++) {
+        pthread_join(readers[i], NULL);
+    }
+    double elapsed = now_seconds() - start;
+    if (has_writer) pthread_join(writer, NULL);
+    
+    free(readers);
+    free(args);
+    *misses = atomic_load(&bench->misses);
+    return started > 0 ? atomic_load(&bench->lookups) / elapsed : -1;
+}
+
+void bench_tree_concurrent(int max_threads, int num_keys) {
+    if (max_threads <= 0 || num_keys <= 0) return;
+    
+    char *keys = make_keys(num_keys);
+    BPlusTree *tree = bplus_tree_init();
+    if (!keys || !tree) {
+        free(keys);
+        bplus_tree_free(tree);
+        return;
+    }
+    
+    for (int i = 0; i < num_keys; i++) {
+        bplus_tree_insert(tree, keys + (size_t)i * BENCH_KEY_LEN, keys + (size_t)i * BENCH_KEY_LEN);
+    }
+    
+    pthread_mutex_t global;
+    pthread_mutex_init(&global, NULL);
+    ConcurrentBench bench = { .tree = tree, .keys = keys, .num_keys = num_keys };
+    
+    printf("Búsquedas concurrentes: %d claves, un escritor de fondo, %.1f s por prueba\n",
+           num_keys, BENCH_CONCURRENT_SECONDS);
+    printf("  %-6s %16s %16s\n", "hilos", "mutex global/s", "latches/s");
+    
+    // Potencias de dos y, al final, el máximo pedido
+    for (int threads = 1; threads <= max_threads;
+         threads = threads < max_threads && threads * 2 > max_threads ? max_threads : threads * 2) {
+        long long locked_misses, latched_misses;
+        
+        bench.global = &global;
+        bplus_tree_set_concurrent(tree, 0);
+        double locked = run_concurrent(&bench, threads, &locked_misses);
+        
+        bench.global = NULL;
+        bplus_tree_set_concurrent(tree, 1);
+        double latched = run_concurrent(&bench, threads, &latched_misses);
+        bplus_tree_set_concurrent(tree, 0);
+        
+        if (locked < 0 || latched < 0) {
+            printf("  No se pudieron lanzar los hilos\n");
+            break;
+        }
+        printf("  %-6d %16.0f %16.0f%s\n", threads, locked, latched,
+               locked_misses || latched_misses ? "  (¡claves no encontradas!)" : "");
+    }
+    
+    pthread_mutex_destroy(&global);
+    bplus_tree_free(tree);
+    free(keys);
+}
+
+#define BENCH_CODEC_RUNS 3
+
+// Comprime el archivo por bloques como lo haría el sistema; de cada códec,
+// la mejor de varias pasadas y una comprobación de ida y vuelta
+static int bench_codec(CodecId id, const uint8_t *data, size_t size, size_t num_chunks,
+                       uint8_t **blocks, size_t *block_sizes, uint8_t *check) {
+    const size_t chunk = BATTLEFS_CHUNK_SIZE;
+    double encode_time = 0, decode_time = 0;
+    size_t compressed = 0, stored = 0;
+    CodecStats stats;
+    int status = 0;
+
+    for (int run = 0; run < BENCH_CODEC_RUNS && status == 0; run++) {
+        compressed = stored = 0;
+        memset(&stats, 0, sizeof(stats));
+        double start = now_seconds();
+        for (size_t i = 0; i < num_chunks && status == 0; i++) {
+            size_t len = size - i * chunk < chunk ? size - i * chunk : chunk;
+            free(blocks[i]);
+            blocks[i] = id == CODEC_AUTO
+                        ? codec_encode_auto(data + i * chunk, len, &block_sizes[i], &stats)
+                        : codec_encode(id, data + i * chunk, len, &block_sizes[i]);
+            if (!blocks[i]) status = -1;
+            else {
+                compressed += block_sizes[i];
+                if (codec_block_id(blocks[i], block_sizes[i]) == CODEC_STORED) stored++;
+            }
+        }
+        double elapsed = now_seconds() - start;
+        if (run == 0 || elapsed < encode_time) encode_time = elapsed;
+
+        start = now_seconds();
+        for (size_t i = 0; i < num_chunks && status == 0; i++) {
+            size_t len = size - i * chunk < chunk ? size - i * chunk : chunk;
+            status = codec_decode(blocks[i], block_sizes[i], check + i * chunk, len);
+        }
+        elapsed = now_seconds() - start;
+        if (run == 0 || elapsed < decode_time) decode_time = elapsed;
+    }
+    if (status == 0 && memcmp(check, data, size) != 0) status = -1;
+
+    printf("  %-8s %12zu %7.2f%% %6zu/%-6zu %9.1f %9.1f%s\n", codec_name(id), compressed,
+           100.0 - 100.0 * compressed / size, stored, num_chunks,
+           size / encode_time / 1e6, size / decode_time / 1e6,
+           status != 0 ? "  (¡no recupera el original!)" : "");
+    if (id == CODEC_AUTO) {
+        printf("  %-8s %12llu estimado; bloques:", "", (unsigned long long)stats.estimated_size);
+        for (int i = 0; i < CODEC_COUNT; i++) {
+            if (stats.chunks[i]) printf(" %s %u", codec_name(i), stats.chunks[i]);
+        }
+        printf("\n");
+    }
+    return status;
+}
+
+void bench_codecs(const char *path) {
+    FILE *file = path ? fopen(path, "rb") : NULL;
+    if (!file) {
+        perror("Error al abrir archivo");
+        return;
+    }
+
+    long length = fseek(file, 0, SEEK_END) == 0 ? ftell(file) : -1;
+    size_t size = length > 0 ? (size_t)length : 0;
+    uint8_t *data = size ? malloc(size) : NULL;
+    int status = data && fseek(file, 0, SEEK_SET) == 0 &&
+                 fread(data, 1, size, file) == size ? 0 : -1;
+    fclose(file);
+    if (status != 0) {
+        printf("No se pudo leer el archivo (o está vacío)\n");
+        free(data);
+        return;
+    }
+
+    size_t num_chunks = (size + BATTLEFS_CHUNK_SIZE - 1) / BATTLEFS_CHUNK_SIZE;
+    uint8_t **blocks = calloc(num_chunks, sizeof(uint8_t*));
+    size_t *block_sizes = calloc(num_chunks, sizeof(size_t));
+    uint8_t *check = malloc(size);
+    if (blocks && block_sizes && check) {
+        printf("Códecs: %zu bytes en bloques de %d KB, mejor de %d pasadas\n",
+               size, BATTLEFS_CHUNK_SIZE / 1024, BENCH_CODEC_RUNS);
+        printf("  %-9s %12s %8s %13s %9s %9s\n", "códec", "comprimido", "ahorro",
+               "sin reducir", "comp MB/s", "desc MB/s");
+        for (int id = 0; id <= CODEC_AUTO; id++) {
+            bench_codec((CodecId)id, data, size, num_chunks, blocks, block_sizes, check);
+        }
+    }
+
+    for (size_t i = 0; blocks && i < num_chunks; i++) {
+        free(blocks[i]);
+    }
+    free(blocks);
+    free(block_sizes);
+    free(check);
+    free(data);
+}
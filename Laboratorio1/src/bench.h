@@ -0,0 +1,12 @@
+
+#ifndef BENCH_H
+#define BENCH_H
+
+// Pruebas de rendimiento lanzadas desde la consola
+void bench_tree_search(int num_keys);
+// Lectores en paralelo con un escritor: mutex global frente a latches
+void bench_tree_concurrent(int max_threads, int num_keys);
+// Tamaño y velocidad de cada códec sobre los bloques de un archivo
+void bench_codecs(const char *path);
+
+#endif
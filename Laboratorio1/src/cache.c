@@ -0,0 +1,218 @@
+
+#define _POSIX_C_SOURCE 200809L
+#include "cache.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define CACHE_INITIAL_BUCKETS 64
+
+static uint64_t block_hash(uint64_t file, size_t chunk) {
+    // FNV-1a sobre el id del archivo, mezclado con el índice de bloque
+    uint64_t hash = 14695981039346656037ULL;
+    hash ^= file;
+    hash *= 1099511628211ULL;
+    hash ^= chunk;
+    hash *= 1099511628211ULL;
+    return hash ^ (hash >> 29);
+}
+
+BlockCache* block_cache_init(size_t budget_bytes) {
+    BlockCache *cache = calloc(1, sizeof(BlockCache));
+    if (!cache) return NULL;
+
+    cache->buckets = calloc(CACHE_INITIAL_BUCKETS, sizeof(CacheBlock*));
+    if (!cache->buckets) {
+        free(cache);
+        return NULL;
+    }
+
+    cache->num_buckets = CACHE_INITIAL_BUCKETS;
+    cache->budget_bytes = budget_bytes;
+    pthread_mutex_init(&cache->lock, NULL);
+    return cache;
+}
+
+static void block_free(CacheBlock *block) {
+    free(block->data);
+    free(block);
+}
+
+void block_cache_free(BlockCache *cache) {
+    if (!cache) return;
+
+    CacheBlock *block = cache->head;
+    while (block) {
+        CacheBlock *next = block->next;
+        block_free(block);
+        block = next;
+    }
+
+    pthread_mutex_destroy(&cache->lock);
+    free(cache->buckets);
+    free(cache);
+}
+
+static CacheBlock** find_slot(BlockCache *cache, uint64_t file, size_t chunk, uint64_t hash) {
+    CacheBlock **slot = &cache->buckets[hash & (cache->num_buckets - 1)];
+    while (*slot) {
+        CacheBlock *block = *slot;
+        if (block->hash == hash && block->chunk == chunk && block->file == file) {
+            break;
+        }
+        slot = &block->chain;
+    }
+    return slot;
+}
+
+static void lru_unlink(BlockCache *cache, CacheBlock *block) {
+    if (block->prev) block->prev->next = block->next;
+    else cache->head = block->next;
+    if (block->next) block->next->prev = block->prev;
+    else cache->tail = block->prev;
+    block->prev = block->next = NULL;
+}
+
+static void lru_push_front(BlockCache *cache, CacheBlock *block) {
+    block->prev = NULL;
+    block->next = cache->head;
+    if (cache->head) cache->head->prev = block;
+    cache->head = block;
+    if (!cache->tail) cache->tail = block;
+}
+
+// Un bloque fijado sale de la caché pero lo libera su último lector
+static void remove_block(BlockCache *cache, CacheBlock *block) {
+    CacheBlock **slot = find_slot(cache, block->file, block->chunk, block->hash);
+    *slot = block->chain;
+    lru_unlink(cache, block);
+    cache->used_bytes -= block->size;
+    cache->count--;
+    block->cached = 0;
+    if (block->refs == 0) block_free(block);
+}
+
+static void grow_buckets(BlockCache *cache) {
+    size_t new_count = cache->num_buckets * 2;
+    CacheBlock **buckets = calloc(new_count, sizeof(CacheBlock*));
+    if (!buckets) return;
+
+    for (size_t i = 0; i < cache->num_buckets; i++) {
+        CacheBlock *block = cache->buckets[i];
+        while (block) {
+            CacheBlock *chain = block->chain;
+            size_t index = block->hash & (new_count - 1);
+            block->chain = buckets[index];
+            buckets[index] = block;
+            block = chain;
+        }
+    }
+
+    free(cache->buckets);
+    cache->buckets = buckets;
+    cache->num_buckets = new_count;
+}
+
+CacheBlock* block_cache_get(BlockCache *cache, uint64_t file, size_t chunk) {
+    if (!cache) return NULL;
+
+    uint64_t hash = block_hash(file, chunk);
+    pthread_mutex_lock(&cache->lock);
+
+    CacheBlock *block = *find_slot(cache, file, chunk, hash);
+    if (block) {
+        block->refs++;
+        lru_unlink(cache, block);
+        lru_push_front(cache, block);
+        cache->hits++;
+    } else {
+        cache->misses++;
+    }
+
+    pthread_mutex_unlock(&cache->lock);
+    return block;
+}
+
+// Inserta el bloque expulsando los menos recientes si hace falta. Uno mayor
+// que todo el presupuesto se entrega igual, pero sin quedarse en la caché
+CacheBlock* block_cache_put(BlockCache *cache, uint64_t file, size_t chunk,
+                            uint8_t *data, size_t size) {
+    if (!cache || !data) {
+        free(data);
+        return NULL;
+    }
+
+    CacheBlock *block = calloc(1, sizeof(CacheBlock));
+    if (!block) {
+        free(data);
+        return NULL;
+    }
+    block->data = data;
+    block->size = size;
+    block->file = file;
+    block->chunk = chunk;
+    block->hash = block_hash(file, chunk);
+    block->refs = 1;
+
+    if (size > cache->budget_bytes) return block;
+
+    pthread_mutex_lock(&cache->lock);
+
+    // Otro lector lo decodificó a la vez: se usa el suyo
+    CacheBlock *existing = *find_slot(cache, file, chunk, block->hash);
+    if (existing) {
+        existing->refs++;
+        pthread_mutex_unlock(&cache->lock);
+        block_free(block);
+        return existing;
+    }
+
+    while (cache->tail && cache->used_bytes + size > cache->budget_bytes) {
+        remove_block(cache, cache->tail);
+        cache->evictions++;
+    }
+
+    if (cache->count >= cache->num_buckets) grow_buckets(cache);
+
+    CacheBlock **bucket = &cache->buckets[block->hash & (cache->num_buckets - 1)];
+    block->chain = *bucket;
+    *bucket = block;
+    lru_push_front(cache, block);
+    block->cached = 1;
+    cache->used_bytes += size;
+    cache->count++;
+
+    pthread_mutex_unlock(&cache->lock);
+    return block;
+}
+
+void block_cache_release(BlockCache *cache, CacheBlock *block) {
+    if (!cache || !block) return;
+
+    pthread_mutex_lock(&cache->lock);
+    int last = --block->refs == 0 && !block->cached;
+    pthread_mutex_unlock(&cache->lock);
+    if (last) block_free(block);
+}
+
+void block_cache_invalidate(BlockCache *cache, uint64_t file, size_t num_chunks) {
+    if (!cache) return;
+
+    pthread_mutex_lock(&cache->lock);
+    for (size_t i = 0; i < num_chunks; i++) {
+        CacheBlock *block = *find_slot(cache, file, i, block_hash(file, i));
+        if (block) remove_block(cache, block);
+    }
+    pthread_mutex_unlock(&cache->lock);
+}
+
+void block_cache_stats(BlockCache *cache, BlockCacheStats *stats) {
+    if (!cache || !stats) return;
+
+    pthread_mutex_lock(&cache->lock);
+    stats->hits = cache->hits;
+    stats->misses = cache->misses;
+    stats->evictions = cache->evictions;
+    stats->used_bytes = cache->used_bytes;
+    stats->budget_bytes = cache->budget_bytes;
+    pthread_mutex_unlock(&cache->lock);
+}
@@ -0,0 +1,62 @@
+
+#ifndef CACHE_H
+#define CACHE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <pthread.h>
+
+// Caché LRU de bloques descomprimidos, limitada en bytes y clave (archivo, bloque).
+// El archivo se identifica por un id que no se reutiliza: un bloque que un
+// lector guarde tras borrarse el archivo nunca se confunde con otro posterior.
+// Los lectores reciben el bloque fijado y leen data sin copiarlo
+typedef struct CacheBlock {
+    uint64_t file;
+    size_t chunk;
+    uint64_t hash;
+    uint8_t *data;
+    size_t size;
+    int refs;                   // Lectores que lo tienen fijado (con el cerrojo)
+    int cached;                 // Sigue en la caché; si no, lo libera el último lector
+    struct CacheBlock *prev;    // Lista LRU: head es el más reciente
+    struct CacheBlock *next;
+    struct CacheBlock *chain;   // Siguiente en el mismo cubo
+} CacheBlock;
+
+typedef struct {
+    CacheBlock **buckets;
+    size_t num_buckets;
+    CacheBlock *head;
+    CacheBlock *tail;
+    size_t count;
+    size_t used_bytes;
+    size_t budget_bytes;
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t evictions;
+    pthread_mutex_t lock;
+} BlockCache;
+
+// Copia de los contadores tomada con el cerrojo
+typedef struct {
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t evictions;
+    size_t used_bytes;
+    size_t budget_bytes;
+} BlockCacheStats;
+
+BlockCache* block_cache_init(size_t budget_bytes);
+void block_cache_free(BlockCache *cache);
+// Bloque fijado o NULL si no está; sigue válido hasta block_cache_release
+// aunque entretanto se expulse
+CacheBlock* block_cache_get(BlockCache *cache, uint64_t file, size_t chunk);
+// Se queda con data (de malloc) y devuelve el bloque ya fijado. NULL si no
+// hay memoria, y entonces libera data
+CacheBlock* block_cache_put(BlockCache *cache, uint64_t file, size_t chunk,
+                            uint8_t *data, size_t size);
+void block_cache_release(BlockCache *cache, CacheBlock *block);
+void block_cache_invalidate(BlockCache *cache, uint64_t file, size_t num_chunks);
+void block_cache_stats(BlockCache *cache, BlockCacheStats *stats);
+
+#endif
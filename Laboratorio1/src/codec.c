@@ -0,0 +1,432 @@
+
+#define _POSIX_C_SOURCE 200809L
+#include "codec.h"
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <math.h>
+
+// --- Sin comprimir ---
+
+static size_t stored_bound(size_t size) {
+    return size;
+}
+
+static int stored_compress(const uint8_t *in, size_t size, uint8_t *out, size_t cap, size_t *out_size) {
+    if (cap < stored_bound(size)) return -1;
+    if (size > 0) memcpy(out, in, size);
+    *out_size = size;
+    return 0;
+}
+
+static int stored_decompress(const uint8_t *in, size_t size, uint8_t *out, size_t out_size) {
+    if (size != out_size) return -1;
+    if (size > 0) memcpy(out, in, size);
+    return 0;
+}
+
+// --- RLE ---
+
+// Cada tramo de literales cuesta un byte de control y cada repetición ahorra
+// al menos uno, así que solo los literales pueden crecer
+static size_t rle_bound(size_t size) {
+    return size + size / RLE_MAX_LITERALS + 2;
+}
+
+static size_t rle_literals(const uint8_t *in, size_t size, uint8_t *out, size_t op) {
+    while (size > 0) {
+        size_t take = size < RLE_MAX_LITERALS ? size : RLE_MAX_LITERALS;
+        out[op++] = (uint8_t)(take - 1);
+        memcpy(out + op, in, take);
+        op += take;
+        in += take;
+        size -= take;
+    }
+    return op;
+}
+
+static int rle_compress(const uint8_t *in, size_t size, uint8_t *out, size_t cap, size_t *out_size) {
+    if (cap < rle_bound(size)) return -1;
+
+    size_t op = 0;
+    size_t anchor = 0;
+    size_t ip = 0;
+
+    while (ip < size) {
+        size_t run = 1;
+        while (ip + run < size && run < RLE_MAX_RUN && in[ip + run] == in[ip]) run++;
+
+        if (run >= RLE_MIN_RUN) {
+            op = rle_literals(in + anchor, ip - anchor, out, op);
+            out[op++] = (uint8_t)(128 + run - RLE_MIN_RUN);
+            out[op++] = in[ip];
+            anchor = ip + run;
+        }
+        ip += run;
+    }
+
+    *out_size = rle_literals(in + anchor, size - anchor, out, op);
+    return 0;
+}
+
+static int rle_decompress(const uint8_t *in, size_t size, uint8_t *out, size_t out_size) {
+    size_t ip = 0;
+    size_t op = 0;
+
+    while (ip < size) {
+        uint8_t control = in[ip++];
+        if (control < 128) {
+            size_t len = (size_t)control + 1;
+            if (len > size - ip || len > out_size - op) return -1;
+            memcpy(out + op, in + ip, len);
+            ip += len;
+            op += len;
+        } else {
+            size_t len = (size_t)control - 128 + RLE_MIN_RUN;
+            if (ip >= size || len > out_size - op) return -1;
+            memset(out + op, in[ip++], len);
+            op += len;
+        }
+    }
+    return op == out_size ? 0 : -1;
+}
+
+// --- LZ77 ---
+
+static size_t lz77_bound(size_t size) {
+    return size + size / 255 + 16;
+}
+
+static inline uint32_t read32(const uint8_t *p) {
+    uint32_t value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+static inline uint32_t lz77_hash(uint32_t sequence) {
+    return (sequence * 2654435761u) >> (32 - LZ77_HASH_BITS);
+}
+
+// Longitud que no cabe en los 4 bits del token: bytes de 255 y el resto
+static size_t lz77_put_length(uint8_t *out, size_t op, size_t len) {
+    while (len >= 255) {
+        out[op++] = 255;
+        len -= 255;
+    }
+    out[op++] = (uint8_t)len;
+    return op;
+}
+
+// match_len == 0 marca la última secuencia, solo de literales
+static size_t lz77_sequence(uint8_t *out, size_t op, const uint8_t *literals,
+                            size_t literal_len, size_t offset, size_t match_len) {
+    size_t extra = match_len ? match_len - LZ77_MIN_MATCH : 0;
+    out[op++] = (uint8_t)(((literal_len < 15 ? literal_len : 15) << 4) |
+                          (extra < 15 ? extra : 15));
+    if (literal_len >= 15) op = lz77_put_length(out, op, literal_len - 15);
+    memcpy(out + op, literals, literal_len);
+    op += literal_len;
+
+    if (match_len) {
+        out[op++] = (uint8_t)offset;
+        out[op++] = (uint8_t)(offset >> 8);
+        if (extra >= 15) op = lz77_put_length(out, op, extra - 15);
+    }
+    return op;
+}
+
+// La tabla guarda posiciones más base: con una base mayor que las de usos
+// anteriores, sus entradas dan una referencia fuera de rango y cuentan como
+// fallo, así que se reutiliza sin limpiarla. base + size cabe en 32 bits
+static void lz77_encode(const uint8_t *in, size_t size, uint8_t *out, size_t *out_size,
+                        uint32_t *table, uint32_t base) {
+    size_t op = 0;
+    size_t anchor = 0;
+    size_t ip = 0;
+    size_t misses = 0;
+
+    while (size >= LZ77_MIN_MATCH && ip <= size - LZ77_MIN_MATCH) {
+        uint32_t sequence = read32(in + ip);
+        uint32_t h = lz77_hash(sequence);
+        size_t ref = (uint32_t)(table[h] - base);
+        table[h] = base + (uint32_t)ip;
+
+        if (ref >= ip || ip - ref > LZ77_WINDOW || read32(in + ref) != sequence) {
+            // Datos sin repeticiones: se salta cada vez más rápido
+            ip += 1 + (misses++ >> LZ77_SKIP_TRIGGER);
+            continue;
+        }
+
+        size_t len = LZ77_MIN_MATCH;
+        while (ip + len < size && in[ref + len] == in[ip + len]) len++;
+
+        op = lz77_sequence(out, op, in + anchor, ip - anchor, ip - ref, len);
+        ip += len;
+        anchor = ip;
+        misses = 0;
+
+        // Posición cercana al final de la coincidencia para la siguiente
+        if (ip >= 2 && ip - 2 <= size - LZ77_MIN_MATCH) {
+            table[lz77_hash(read32(in + ip - 2))] = base + (uint32_t)(ip - 2);
+        }
+    }
+
+    *out_size = lz77_sequence(out, op, in + anchor, size - anchor, 0, 0);
+}
+
+static int lz77_compress(const uint8_t *in, size_t size, uint8_t *out, size_t cap, size_t *out_size) {
+    if (cap < lz77_bound(size)) return -1;
+
+    uint32_t *table = calloc((size_t)1 << LZ77_HASH_BITS, sizeof(uint32_t));
+    if (!table) return -1;
+    lz77_encode(in, size, out, out_size, table, 0);
+    free(table);
+    return 0;
+}
+
+// Extensión de longitud tras un 15 en el token
+static int lz77_get_length(const uint8_t *in, size_t size, size_t *ip, size_t *len) {
+    uint8_t byte;
+    do {
+        if (*ip >= size) return -1;
+        byte = in[(*ip)++];
+        *len += byte;
+    } while (byte == 255);
+    return 0;
+}
+
+static int lz77_decompress(const uint8_t *in, size_t size, uint8_t *out, size_t out_size) {
+    size_t ip = 0;
+    size_t op = 0;
+
+    while (ip < size) {
+        uint8_t token = in[ip++];
+
+        size_t literal_len = token >> 4;
+        if (literal_len == 15 && lz77_get_length(in, size, &ip, &literal_len) != 0) return -1;
+        if (literal_len > size - ip || literal_len > out_size - op) return -1;
+        memcpy(out + op, in + ip, literal_len);
+        ip += literal_len;
+        op += literal_len;
+        if (ip == size) break;
+
+        if (size - ip < 2) return -1;
+        size_t offset = (size_t)in[ip] | ((size_t)in[ip + 1] << 8);
+        ip += 2;
+        if (offset == 0 || offset > op) return -1;
+
+        size_t match_len = token & 15;
+        if (match_len == 15 && lz77_get_length(in, size, &ip, &match_len) != 0) return -1;
+        match_len += LZ77_MIN_MATCH;
+        if (match_len > out_size - op) return -1;
+
+        // Con solapamiento la copia debe ir byte a byte
+        const uint8_t *src = out + op - offset;
+        if (offset >= match_len) {
+            memcpy(out + op, src, match_len);
+        } else {
+            for (size_t i = 0; i < match_len; i++) out[op + i] = src[i];
+        }
+        op += match_len;
+    }
+    return op == out_size ? 0 : -1;
+}
+
+// --- LZW ---
+
+static size_t lzw_bound(size_t size) {
+    return sizeof(LZWStreamHeader) + (size * LZW_MAX_CODE_WIDTH + 7) / 8 + 8;
+}
+
+static const Codec codecs[CODEC_COUNT] = {
+    { CODEC_STORED, "stored", stored_bound, stored_compress, stored_decompress },
+    { CODEC_RLE, "rle", rle_bound, rle_compress, rle_decompress },
+    { CODEC_LZ77, "lz77", lz77_bound, lz77_compress, lz77_decompress },
+    { CODEC_LZW, "lzw", lzw_bound, lzw_compress_into, lzw_decompress_into },
+};
+
+const Codec* codec_get(CodecId id) {
+    return (unsigned)id < CODEC_COUNT ? &codecs[id] : NULL;
+}
+
+int codec_from_name(const char *name) {
+    if (name && strcasecmp(name, "auto") == 0) return CODEC_AUTO;
+    for (int i = 0; name && i < CODEC_COUNT; i++) {
+        if (strcasecmp(name, codecs[i].name) == 0) return i;
+    }
+    return -1;
+}
+
+const char* codec_name(CodecId id) {
+    if (id == CODEC_AUTO) return "auto";
+    const Codec *codec = codec_get(id);
+    return codec ? codec->name : "?";
+}
+
+uint8_t* codec_encode(CodecId id, const uint8_t *in, size_t size, size_t *out_size) {
+    if (id == CODEC_AUTO) return codec_encode_auto(in, size, out_size, NULL);
+
+    const Codec *codec = codec_get(id);
+    if (!codec || !out_size || (!in && size > 0)) return NULL;
+
+    size_t bound = codec->bound(size);
+    uint8_t *out = malloc(1 + (bound > size ? bound : size));
+    if (!out) return NULL;
+
+    size_t compressed;
+    if (codec->compress(in, size, out + 1, bound, &compressed) == 0 && compressed < size) {
+        out[0] = (uint8_t)id;
+        *out_size = 1 + compressed;
+        return out;
+    }
+
+    // Incompresible (o el códec falló): mejor un byte de más que expandir
+    out[0] = CODEC_STORED;
+    if (size > 0) memcpy(out + 1, in, size);
+    *out_size = 1 + size;
+    return out;
+}
+
+int codec_block_id(const uint8_t *in, size_t size) {
+    if (!in || size < 1 || !codec_get((CodecId)in[0])) return -1;
+    return in[0];
+}
+
+int codec_decode(const uint8_t *in, size_t size, uint8_t *out, size_t out_size) {
+    int id = codec_block_id(in, size);
+    if (id < 0 || (!out && out_size > 0)) return -1;
+    return codecs[id].decompress(in + 1, size - 1, out, out_size);
+}
+
+int codec_decode_to_sink(const uint8_t *in, size_t size, size_t out_size,
+                         LZWSink sink, void *ctx) {
+    int id = codec_block_id(in, size);
+    if (id < 0 || !sink) return -1;
+
+    // LZW sabe decodificar por ventanas sin el bloque entero
+    if (id == CODEC_LZW) {
+        LZWStreamHeader header;
+        if (size - 1 < sizeof(header)) return -1;
+        memcpy(&header, in + 1, sizeof(header));
+        if (header.original_size != out_size) return -1;
+        return lzw_decompress_to_sink(in + 1, size - 1, sink, ctx);
+    }
+
+    uint8_t *out = malloc(out_size ? out_size : 1);
+    if (!out) return -1;
+
+    int status = codecs[id].decompress(in + 1, size - 1, out, out_size);
+    for (size_t pos = 0; status == 0 && pos < out_size; pos += LZW_SINK_WINDOW) {
+        size_t take = out_size - pos < LZW_SINK_WINDOW ? out_size - pos : LZW_SINK_WINDOW;
+        status = sink(out + pos, take, ctx);
+    }
+    free(out);
+    return status;
+}
+
+static double entropy_of(const uint32_t counts[256], size_t size) {
+    if (size == 0) return 0;
+
+    double bits = 0;
+    for (int i = 0; i < 256; i++) {
+        if (counts[i] == 0) continue;
+        double p = (double)counts[i] / size;
+        bits -= p * log2(p);
+    }
+    return bits;
+}
+
+double codec_entropy(const uint8_t *data, size_t size) {
+    if (!data) return 0;
+
+    uint32_t counts[256] = {0};
+    for (size_t i = 0; i < size; i++) counts[data[i]]++;
+    return entropy_of(counts, size);
+}
+
+// Tasa de LZW sobre una fuente sin memoria de 2^bits símbolos equiprobables:
+// el diccionario aprende todas las cadenas de longitud n y parte de las de
+// n + 1, y cada código de 12 bits cubre de media una de esa longitud.
+// Ignora las repeticiones largas, así que con texto se queda corto
+static double lzw_estimate(double bits) {
+    double symbols = exp2(bits);
+    double learned = LZW_DICT_SIZE - 256;
+    double level = symbols;     // Cadenas distintas de la longitud actual
+    double length = 1;
+
+    while (learned >= level * symbols) {
+        level *= symbols;
+        learned -= level;
+        length++;
+    }
+    length += learned / (level * symbols);
+    return LZW_MAX_CODE_WIDTH / (8.0 * length);
+}
+
+// La muestra son CODEC_SAMPLE_SLICES trozos repartidos por el bloque, del
+// comienzo al final. LZ77 se prueba de verdad sobre cada trozo, que para
+// él es barato; LZW se estima por la entropía de todos juntos. LZW, más
+// lento, solo gana si promete claramente menos; si nada ahorra, tal cual
+CodecId codec_choose(const uint8_t *data, size_t size, double *ratio) {
+    size_t slice = CODEC_SAMPLE_SIZE / CODEC_SAMPLE_SLICES;
+    size_t slices = CODEC_SAMPLE_SLICES;
+    if (size <= CODEC_SAMPLE_SIZE) {
+        slice = size;
+        slices = 1;
+    }
+
+    uint32_t counts[256] = {0};
+    size_t sampled = 0;
+    size_t lz77_size = 0;
+    uint8_t out[CODEC_SAMPLE_SIZE + CODEC_SAMPLE_SIZE / 255 + 16];
+    // Una tabla para todos los trozos; sin memoria cuentan como no reducidos
+    uint32_t *table = calloc((size_t)1 << LZ77_HASH_BITS, sizeof(uint32_t));
+    for (size_t i = 0; i < slices; i++) {
+        const uint8_t *start = data + (slices > 1 ? (size - slice) * i / (slices - 1) : 0);
+        for (size_t j = 0; j < slice; j++) counts[start[j]]++;
+
+        size_t out_size = slice;
+        if (slice > 0 && table) lz77_encode(start, slice, out, &out_size, table, (uint32_t)sampled);
+        lz77_size += out_size;
+        sampled += slice;
+    }
+    free(table);
+
+    double lz77 = sampled ? (double)lz77_size / sampled : 1.0;
+    double lzw = lzw_estimate(entropy_of(counts, sampled));
+
+    int strong = lzw < lz77 * CODEC_LZW_MARGIN;
+    CodecId id = strong ? CODEC_LZW : CODEC_LZ77;
+    double best = strong ? lzw : lz77;
+    if (best >= CODEC_STORE_RATIO) {
+        id = CODEC_STORED;
+        best = 1.0;
+    }
+    if (ratio) *ratio = best;
+    return id;
+}
+
+uint8_t* codec_encode_auto(const uint8_t *in, size_t size, size_t *out_size, CodecStats *stats) {
+    double ratio;
+    CodecId id = codec_choose(in, size, &ratio);
+    uint8_t *out = codec_encode(id, in, size, out_size);
+    if (!out || !stats) return out;
+
+    int final = out[0];
+    stats->chunks[final]++;
+    if (id != CODEC_STORED && final == CODEC_STORED) stats->fallbacks++;
+    stats->original_size += size;
+    stats->estimated_size += 1 + (uint64_t)(ratio * size + 0.5);
+    stats->actual_size += *out_size;
+    return out;
+}
+
+void codec_stats_add(CodecStats *into, const CodecStats *from) {
+    for (int i = 0; i < CODEC_COUNT; i++) {
+        into->chunks[i] += from->chunks[i];
+    }
+    into->fallbacks += from->fallbacks;
+    into->original_size += from->original_size;
+    into->estimated_size += from->estimated_size;
+    into->actual_size += from->actual_size;
+}
@@ -0,0 +1,94 @@
+
+#ifndef CODEC_H
+#define CODEC_H
+
+#include "compression.h"
+#include <stdint.h>
+#include <stddef.h>
+
+// Identificadores estables: se guardan en imagen, diario y en cada bloque
+typedef enum {
+    CODEC_STORED = 0,   // Sin comprimir
+    CODEC_RLE = 1,      // Repeticiones de un byte
+    CODEC_LZ77 = 2,     // Coincidencias en una ventana de 64 KB, estilo LZ4
+    CODEC_LZW = 3,
+    CODEC_COUNT,
+    CODEC_AUTO = CODEC_COUNT    // Elige por bloque tras muestrearlo; no se guarda
+} CodecId;
+
+// RLE: byte de control < 128 -> siguen control + 1 literales;
+// >= 128 -> el byte siguiente se repite control - 128 + RLE_MIN_RUN veces
+#define RLE_MIN_RUN 3
+#define RLE_MAX_LITERALS 128
+#define RLE_MAX_RUN (127 + RLE_MIN_RUN)
+
+// LZ77: secuencias token | literales | desplazamiento (16 bits) | longitud.
+// El token lleva 4 bits de literales y 4 de coincidencia (menos el mínimo);
+// 15 indica que siguen bytes de extensión. La última secuencia no tiene
+// coincidencia
+#define LZ77_MIN_MATCH 4
+#define LZ77_HASH_BITS 14
+#define LZ77_WINDOW 65535
+#define LZ77_SKIP_TRIGGER 6     // Tras 2^n fallos se avanza de dos en dos, etc.
+
+// Modo automático: se muestrean unos KB de cada bloque (el comienzo y
+// trozos repartidos) y se guarda tal cual si ningún códec promete ahorrar
+// al menos un 5%
+#ifndef CODEC_SAMPLE_SIZE
+#define CODEC_SAMPLE_SIZE 4096
+#endif
+#ifndef CODEC_SAMPLE_SLICES
+#define CODEC_SAMPLE_SLICES 4
+#endif
+// LZW es unas tres veces más lento que LZ77: se elige si su estimación es
+// menor que este factor por la de LZ77
+#define CODEC_LZW_MARGIN 0.8
+#define CODEC_STORE_RATIO 0.95
+
+// Decisiones del modo automático. Los bloques se cuentan por el códec con el
+// que quedaron; fallbacks son los que se eligieron para comprimir y no redujeron
+typedef struct {
+    uint32_t chunks[CODEC_COUNT];
+    uint32_t fallbacks;
+    uint64_t original_size;
+    uint64_t estimated_size;
+    uint64_t actual_size;
+} CodecStats;
+
+typedef struct {
+    CodecId id;
+    const char *name;
+    // Tamaño máximo de la salida para size bytes de entrada
+    size_t (*bound)(size_t size);
+    // -1 si cap es menor que bound(size)
+    int (*compress)(const uint8_t *in, size_t size, uint8_t *out, size_t cap, size_t *out_size);
+    // Reconstruye exactamente out_size bytes; -1 si el flujo no es válido
+    int (*decompress)(const uint8_t *in, size_t size, uint8_t *out, size_t out_size);
+} Codec;
+
+const Codec* codec_get(CodecId id);
+// -1 si el nombre no corresponde a ningún códec
+int codec_from_name(const char *name);
+const char* codec_name(CodecId id);
+
+// Bloque etiquetado: un byte con el códec y su flujo. Si el códec no reduce
+// el bloque, se guarda tal cual (CODEC_STORED)
+uint8_t* codec_encode(CodecId id, const uint8_t *in, size_t size, size_t *out_size);
+int codec_decode(const uint8_t *in, size_t size, uint8_t *out, size_t out_size);
+// Entrega el bloque al sink en trozos de como mucho LZW_SINK_WINDOW bytes
+int codec_decode_to_sink(const uint8_t *in, size_t size, size_t out_size,
+                         LZWSink sink, void *ctx);
+// Códec con el que quedó un bloque etiquetado
+int codec_block_id(const uint8_t *in, size_t size);
+
+// Bits por byte (entropía de orden 0)
+double codec_entropy(const uint8_t *data, size_t size);
+// Códec para un bloque según su muestra; *ratio recibe el tamaño esperado
+// como fracción del original
+CodecId codec_choose(const uint8_t *data, size_t size, double *ratio);
+// codec_encode con el códec que elija codec_choose; anota la decisión en
+// stats si no es NULL
+uint8_t* codec_encode_auto(const uint8_t *in, size_t size, size_t *out_size, CodecStats *stats);
+void codec_stats_add(CodecStats *into, const CodecStats *from);
+
+#endif
@@ -3,148 +3,470 @@
 #include <stdio.h>
 #include <string.h>
 
-uint8_t* lzw_compress(const uint8_t *input, size_t input_size, size_t *output_size) {
-    LZWDictionary dict;
-    // Inicializar diccionario
-    for (int i = 0; i < 256; i++) {
-        dict.entries[i].value = i;
-        for (int j = 0; j < 256; j++) {
-            dict.entries[i].next[j] = LZW_DICT_SIZE;
+typedef struct {
+    const uint8_t *in;
+    size_t size;
+    size_t pos;
+    uint64_t acc;
+    unsigned bits;
+} BitReader;
+
+static inline int bit_read(BitReader *br, unsigned width, uint16_t *code) {
+    if (br->bits < width) {
+        // Rellenar el acumulador de golpe mientras queden bytes
+        while (br->bits <= 56 && br->pos < br->size) {
+            br->acc |= (uint64_t)br->in[br->pos++] << br->bits;
+            br->bits += 8;
         }
+        if (br->bits < width) return -1;
     }
-    dict.size = 256;
+    *code = (uint16_t)(br->acc & ((1u << width) - 1));
+    br->acc >>= width;
+    br->bits -= width;
+    return 0;
+}
 
-    uint16_t *output = malloc(input_size * sizeof(uint16_t));
-    if (!output) return NULL;
+static inline uint32_t dict_slot(uint32_t key) {
+    return (key * 2654435761u) >> (32 - LZW_HASH_BITS);
+}
+
+static void dict_reset(LZWDictionary *dict) {
+    memset(dict->slots, 0, sizeof(dict->slots));
+    dict->size = 256;
+}
+
+// Busca (prefijo, byte); si no existe devuelve la ranura libre en *slot
+static inline uint16_t dict_find(const LZWDictionary *dict, uint16_t prefix,
+                                 uint8_t byte, uint32_t *slot) {
+    uint32_t key = ((uint32_t)prefix << 8) | byte;
+    uint32_t i = dict_slot(key);
+    for (;;) {
+        uint32_t entry = dict->slots[i];
+        if (entry == 0) {
+            *slot = i;
+            return LZW_DICT_SIZE;
+        }
+        if ((entry >> 12) == key) return entry & LZW_MAX_CODE;
+        i = (i + 1) & (LZW_HASH_SIZE - 1);
+    }
+}
+
+// Ancho necesario para emitir un código con el diccionario en dict_size
+unsigned lzw_code_width(size_t dict_size) {
+    unsigned width = LZW_MIN_CODE_WIDTH;
+    while (width < LZW_MAX_CODE_WIDTH && ((size_t)1 << width) < dict_size) {
+        width++;
+    }
+    return width;
+}
+
+static inline void encoder_put(LZWEncoder *enc, uint16_t code) {
+    enc->acc |= (uint64_t)code << enc->bits;
+    enc->bits += lzw_code_width(enc->dict.size);
+    while (enc->bits >= 8) {
+        enc->output[enc->pos++] = (uint8_t)enc->acc;
+        enc->acc >>= 8;
+        enc->bits -= 8;
+    }
+    enc->header.num_codes++;
+}
+
+// Garantiza hueco para los códigos que pueden salir de size bytes más
+static int encoder_reserve(LZWEncoder *enc, size_t size) {
+    size_t needed = enc->pos + (size * LZW_MAX_CODE_WIDTH + 7) / 8 + 8;
+    if (needed <= enc->capacity) return 0;
+
+    size_t capacity = enc->capacity * 2;
+    if (capacity < needed) capacity = needed;
+    uint8_t *output = realloc(enc->output, capacity);
+    if (!output) return -1;
+
+    enc->output = output;
+    enc->capacity = capacity;
+    return 0;
+}
+
+static void encoder_start(LZWEncoder *enc, uint8_t *output, size_t capacity) {
+    dict_reset(&enc->dict);
+    memset(&enc->header, 0, sizeof(enc->header));
+    memcpy(enc->header.magic, LZW_STREAM_MAGIC, sizeof(enc->header.magic));
+    enc->header.version = LZW_STREAM_VERSION;
+
+    enc->output = output;
+    enc->capacity = capacity;
 
-    size_t output_pos = 0;
-    uint16_t current_code = input[0];
+    // La cabecera se rellena al terminar, cuando se conocen los totales
+    enc->pos = sizeof(LZWStreamHeader);
+    enc->acc = 0;
+    enc->bits = 0;
+    enc->current_code = 0;
+    enc->has_code = 0;
+}
+
+int lzw_encoder_init(LZWEncoder *enc) {
+    if (!enc) return -1;
+
+    uint8_t *output = malloc(LZW_ENCODER_INITIAL_CAPACITY);
+    if (!output) return -1;
+    encoder_start(enc, output, LZW_ENCODER_INITIAL_CAPACITY);
+    return 0;
+}
 
-    for (size_t i = 1; i < input_size; i++) {
-        uint8_t next_char = input[i];
-        uint16_t next_code = dict.entries[current_code].next[next_char];
+int lzw_encoder_feed(LZWEncoder *enc, const uint8_t *data, size_t size) {
+    if (!enc || !enc->output || (!data && size > 0)) return -1;
+    if (size == 0) return 0;
+    if (encoder_reserve(enc, size) != 0) return -1;
+
+    size_t i = 0;
+    if (!enc->has_code) {
+        enc->current_code = data[0];
+        enc->has_code = 1;
+        i = 1;
+    }
+
+    uint16_t current_code = enc->current_code;
+    for (; i < size; i++) {
+        uint8_t next_char = data[i];
+        uint32_t slot;
+        uint16_t next_code = dict_find(&enc->dict, current_code, next_char, &slot);
 
         if (next_code < LZW_DICT_SIZE) {
             current_code = next_code;
         } else {
-            if (output_pos >= input_size) {
-                uint16_t *new_output = realloc(output, (output_pos + 1) * sizeof(uint16_t));
-                if (!new_output) {
-                    free(output);
-                    return NULL;
-                }
-                output = new_output;
-            }
-            output[output_pos++] = current_code;
+            encoder_put(enc, current_code);
             
-            if (dict.size < LZW_DICT_SIZE) {
-                dict.entries[current_code].next[next_char] = dict.size;
-                dict.entries[dict.size].value = next_char;
-                dict.size++;
+            if (enc->dict.size < LZW_DICT_SIZE) {
+                uint32_t key = ((uint32_t)current_code << 8) | next_char;
+                enc->dict.slots[slot] = (key << 12) | enc->dict.size;
+                enc->dict.size++;
             }
             
             current_code = next_char;
         }
     }
 
-    output[output_pos++] = current_code;
-    *output_size = output_pos * sizeof(uint16_t);
-    return (uint8_t*)output;
+    enc->current_code = current_code;
+    enc->header.original_size += size;
+    return 0;
 }
 
-uint8_t* lzw_decompress(const uint8_t *input, size_t input_size, size_t *output_size) {
-    if (!input || input_size == 0 || !output_size) return NULL;
+// Cierra el flujo y entrega el buffer al llamante
+uint8_t* lzw_encoder_finish(LZWEncoder *enc, size_t *output_size) {
+    if (!enc || !enc->output || !output_size) return NULL;
+
+    if (enc->has_code) {
+        encoder_put(enc, enc->current_code);
+        if (enc->bits > 0) {
+            enc->output[enc->pos++] = (uint8_t)enc->acc;
+            enc->acc = 0;
+            enc->bits = 0;
+        }
+    }
+
+    memcpy(enc->output, &enc->header, sizeof(enc->header));
+    uint8_t *output = enc->output;
+    *output_size = enc->pos;
+    enc->output = NULL;
+    return output;
+}
+
+void lzw_encoder_free(LZWEncoder *enc) {
+    if (!enc) return;
+    free(enc->output);
+    enc->output = NULL;
+}
+
+uint8_t* lzw_compress(const uint8_t *input, size_t input_size, size_t *output_size) {
+    if (!output_size || (!input && input_size > 0)) return NULL;
+
+    LZWEncoder *enc = malloc(sizeof(LZWEncoder));
+    if (!enc) return NULL;
 
-    LZWDictionary dict;
     uint8_t *output = NULL;
-    *output_size = 0;
-    
-    // Inicializar diccionario
+    if (lzw_encoder_init(enc) == 0 && lzw_encoder_feed(enc, input, input_size) == 0) {
+        output = lzw_encoder_finish(enc, output_size);
+    }
+    lzw_encoder_free(enc);
+    free(enc);
+    return output;
+}
+
+// Para quien ya tiene dónde dejar el flujo: sin reservas ni copias. El
+// codificador (32 KB de diccionario) se reutiliza por hilo
+int lzw_compress_into(const uint8_t *input, size_t input_size,
+                      uint8_t *output, size_t output_capacity, size_t *output_size) {
+    static _Thread_local LZWEncoder enc;
+
+    if (!output || !output_size || (!input && input_size > 0)) return -1;
+
+    // Con hueco para el peor caso encoder_reserve nunca reasigna output
+    if (output_capacity < sizeof(LZWStreamHeader) + (input_size * LZW_MAX_CODE_WIDTH + 7) / 8 + 8) {
+        return -1;
+    }
+
+    encoder_start(&enc, output, output_capacity);
+    int status = lzw_encoder_feed(&enc, input, input_size);
+    if (status == 0 && !lzw_encoder_finish(&enc, output_size)) status = -1;
+    enc.output = NULL;
+    return status;
+}
+
+static int read_header(const uint8_t *input, size_t input_size, LZWStreamHeader *header) {
+    if (!input || input_size < sizeof(LZWStreamHeader)) return -1;
+
+    memcpy(header, input, sizeof(*header));
+    if (memcmp(header->magic, LZW_STREAM_MAGIC, sizeof(header->magic)) != 0 ||
+        header->version != LZW_STREAM_VERSION) {
+        return -1; // Flujo desconocido
+    }
+
+    // Cada código aporta al menos 9 bits y como mucho LZW_DICT_SIZE bytes
+    size_t payload = input_size - sizeof(*header);
+    if (header->num_codes > payload * 8 / LZW_MIN_CODE_WIDTH ||
+        header->original_size > header->num_codes * LZW_DICT_SIZE ||
+        header->original_size < header->num_codes) {
+        return -1;
+    }
+    return 0;
+}
+
+// Las entradas >= 256 se sobrescriben en cada llamada, así que la tabla
+// se inicializa una sola vez por hilo
+static LZWDecodeTable* thread_table(void) {
+    static _Thread_local LZWDecodeTable table;
+    static _Thread_local int table_ready = 0;
+
+    if (!table_ready) {
+        lzw_decode_table_init(&table);
+        table_ready = 1;
+    }
+    return &table;
+}
+
+void lzw_decode_table_init(LZWDecodeTable *table) {
     for (int i = 0; i < 256; i++) {
-        dict.entries[i].value = i;
-        memset(dict.entries[i].next, 0xFF, sizeof(dict.entries[i].next));
+        table->prefix[i] = LZW_DICT_SIZE;
+        table->suffix[i] = (uint8_t)i;
+        table->length[i] = 1;
     }
-    dict.size = 256;
+}
 
-    const uint16_t *codes = (const uint16_t *)input;
-    size_t num_codes = input_size / sizeof(uint16_t);
-    size_t output_alloc = num_codes * 2;
-    
-    output = malloc(output_alloc);
-    if (!output) return NULL;
+// Decodifica el flujo en output, con hueco para header->original_size bytes
+static int decode_into(LZWDecodeTable *table, const uint8_t *input, size_t input_size,
+                       const LZWStreamHeader *header, uint8_t *output) {
+    size_t payload = input_size - sizeof(*header);
+    size_t total = header->original_size;
+
+    BitReader br = { input + sizeof(*header), payload, 0, 0, 0 };
+    size_t pos = 0;
+    size_t prev_pos = 0;
+    uint16_t prev = LZW_DICT_SIZE;
+    size_t size = 256;
+    unsigned width = LZW_MIN_CODE_WIDTH;
+
+    for (size_t i = 0; i < header->num_codes; i++) {
+        // El codificador emitió el código i con el diccionario en 256 + i
+        if (width < LZW_MAX_CODE_WIDTH && 256 + i > ((size_t)1 << width)) width++;
+        uint16_t code;
+        if (bit_read(&br, width, &code) != 0) return -1;
 
-    for (size_t i = 0; i < num_codes; i++) {
-        if (*output_size + 1 > output_alloc) {
-            output_alloc *= 2;
-            uint8_t *new_output = realloc(output, output_alloc);
-            if (!new_output) {
-                free(output);
-                return NULL;
+        size_t len;
+        if (code < size) {
+            len = table->length[code];
+            if (len > total - pos) return -1;
+
+            if (len > LZW_CHAIN_MAX) {
+                // Cadenas largas: copiar su primera aparición
+                memcpy(output + pos, output + table->offset[code], len);
+            } else {
+                // Recorrer la cadena de prefijos escribiendo de atrás hacia delante
+                uint8_t *p = output + pos + len;
+                uint16_t c = code;
+                while (c >= 256) {
+                    *--p = table->suffix[c];
+                    c = table->prefix[c];
+                }
+                *--p = (uint8_t)c;
             }
-            output = new_output;
+        } else if (code == size && prev < LZW_DICT_SIZE) {
+            // Caso KwKwK: cadena anterior más su primer byte
+            len = (size_t)table->length[prev] + 1;
+            if (len > total - pos) return -1;
+            memcpy(output + pos, output + prev_pos, len - 1);
+            output[pos + len - 1] = output[prev_pos];
+        } else {
+            return -1; // Código inválido
         }
-        
-        uint16_t code = codes[i];
-        if (code >= dict.size) {
-            free(output);
-            return NULL; // Código inválido
+
+        if (prev < LZW_DICT_SIZE && size < LZW_DICT_SIZE) {
+            table->prefix[size] = prev;
+            table->suffix[size] = output[pos];
+            table->length[size] = table->length[prev] + 1;
+            table->offset[size] = prev_pos;
+            size++;
         }
-        
-        output[(*output_size)++] = dict.entries[code].value;
+
+        prev = code;
+        prev_pos = pos;
+        pos += len;
     }
 
+    return pos == total ? 0 : -1;
+}
+
+uint8_t* lzw_decompress_with(LZWDecodeTable *table, const uint8_t *input,
+                             size_t input_size, size_t *output_size) {
+    if (!table || !output_size) return NULL;
+
+    LZWStreamHeader header;
+    if (read_header(input, input_size, &header) != 0) return NULL;
+
+    size_t total = header.original_size;
+    uint8_t *output = malloc(total ? total : 1);
+    if (!output) return NULL;
+
+    if (decode_into(table, input, input_size, &header, output) != 0) {
+        free(output);
+        return NULL;
+    }
+    *output_size = total;
     return output;
 }
 
+uint8_t* lzw_decompress(const uint8_t *input, size_t input_size, size_t *output_size) {
+    return lzw_decompress_with(thread_table(), input, input_size, output_size);
+}
+
+// Para quien ya conoce el tamaño original y tiene dónde dejarlo
+int lzw_decompress_into(const uint8_t *input, size_t input_size,
+                        uint8_t *output, size_t output_size) {
+    LZWStreamHeader header;
+    if (!output || read_header(input, input_size, &header) != 0 ||
+        header.original_size != output_size) {
+        return -1;
+    }
+    return decode_into(thread_table(), input, input_size, &header, output);
+}
+
+// Decodifica en una ventana fija que se entrega al sink cada vez que se
+// llena; la salida completa nunca existe en memoria
+int lzw_decompress_to_sink(const uint8_t *input, size_t input_size, LZWSink sink, void *ctx) {
+    if (!sink) return -1;
+
+    LZWStreamHeader header;
+    if (read_header(input, input_size, &header) != 0) return -1;
+
+    uint8_t *window = malloc(LZW_SINK_WINDOW);
+    if (!window) return -1;
+
+    LZWDecodeTable *table = thread_table();
+    BitReader br = { input + sizeof(header), input_size - sizeof(header), 0, 0, 0 };
+    size_t fill = 0;
+    size_t emitted = 0;
+    uint16_t prev = LZW_DICT_SIZE;
+    size_t size = 256;
+    unsigned width = LZW_MIN_CODE_WIDTH;
+    int status = 0;
+
+    for (size_t i = 0; i < header.num_codes && status == 0; i++) {
+        if (width < LZW_MAX_CODE_WIDTH && 256 + i > ((size_t)1 << width)) width++;
+        uint16_t code;
+        if (bit_read(&br, width, &code) != 0) {
+            status = -1;
+            break;
+        }
+
+        // En el caso KwKwK se escribe la cadena anterior y se repite su primer byte
+        int kwkwk = code == size && prev < LZW_DICT_SIZE;
+        if (code >= size && !kwkwk) {
+            status = -1;
+            break;
+        }
+        uint16_t walk = kwkwk ? prev : code;
+        size_t len = (size_t)table->length[walk] + (kwkwk ? 1 : 0);
+        if (len > header.original_size - emitted) {
+            status = -1;
+            break;
+        }
+
+        if (fill + len > LZW_SINK_WINDOW) {
+            status = sink(window, fill, ctx);
+            fill = 0;
+            if (status != 0) break;
+        }
+
+        uint8_t *p = window + fill + table->length[walk];
+        uint16_t c = walk;
+        while (c >= 256) {
+            *--p = table->suffix[c];
+            c = table->prefix[c];
+        }
+        *--p = (uint8_t)c;
+        if (kwkwk) window[fill + len - 1] = window[fill];
+
+        if (prev < LZW_DICT_SIZE && size < LZW_DICT_SIZE) {
+            table->prefix[size] = prev;
+            table->suffix[size] = window[fill];
+            table->length[size] = table->length[prev] + 1;
+            size++;
+        }
+
+        prev = code;
+        fill += len;
+        emitted += len;
+    }
+
+    if (status == 0 && fill > 0) status = sink(window, fill, ctx);
+    if (status == 0 && emitted != header.original_size) status = -1;
+
+    free(window);
+    return status;
+}
+
 int compress_file(const char *filename, uint8_t **compressed_data, size_t *compressed_size) {
     FILE *file = fopen(filename, "rb");
     if (!file) return -1;
 
-    fseek(file, 0, SEEK_END);
-    long file_size = ftell(file);
-    fseek(file, 0, SEEK_SET);
-
-    if (file_size <= 0) {
+    LZWEncoder *enc = malloc(sizeof(LZWEncoder));
+    uint8_t *buffer = malloc(LZW_STREAM_BUFFER);
+    if (!enc || !buffer || lzw_encoder_init(enc) != 0) {
+        free(enc);
+        free(buffer);
         fclose(file);
         return -1;
     }
 
-    uint8_t *file_data = malloc(file_size);
-    if (!file_data) {
-        fclose(file);
-        return -1;
+    // Alimentar el codificador por trozos: memoria constante y vale para tuberías
+    int status = 0;
+    size_t read;
+    while ((read = fread(buffer, 1, LZW_STREAM_BUFFER, file)) > 0) {
+        if (lzw_encoder_feed(enc, buffer, read) != 0) {
+            status = -1;
+            break;
+        }
     }
-
-    size_t read = fread(file_data, 1, file_size, file);
+    if (ferror(file) || enc->header.original_size == 0) status = -1;
     fclose(file);
+    free(buffer);
 
-    if (read != (size_t)file_size) {
-        free(file_data);
-        return -1;
-    }
-
-    *compressed_data = lzw_compress(file_data, file_size, compressed_size);
-    free(file_data);
+    *compressed_data = status == 0 ? lzw_encoder_finish(enc, compressed_size) : NULL;
+    lzw_encoder_free(enc);
+    free(enc);
 
     return (*compressed_data) ? 0 : -1;
 }
 
+static int file_sink(const uint8_t *data, size_t size, void *ctx) {
+    return fwrite(data, 1, size, (FILE*)ctx) == size ? 0 : -1;
+}
+
 int decompress_to_file(const char *filename, const uint8_t *compressed_data, size_t compressed_size) {
     if (!filename || !compressed_data) return -1;
 
-    size_t output_size;
-    uint8_t *decompressed = lzw_decompress(compressed_data, compressed_size, &output_size);
-    if (!decompressed) return -1;
-
     FILE *file = fopen(filename, "wb");
-    if (!file) {
-        free(decompressed);
-        return -1;
-    }
-
-    size_t written = fwrite(decompressed, 1, output_size, file);
-    fclose(file);
-    free(decompressed);
+    if (!file) return -1;
 
-    return (written == output_size) ? 0 : -1;
+    int status = lzw_decompress_to_sink(compressed_data, compressed_size, file_sink, file);
+    if (fclose(file) != 0) status = -1;
+    return status;
 }
\ No newline at end of file
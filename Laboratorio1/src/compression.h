@@ -8,19 +8,81 @@
 
 #define LZW_DICT_SIZE 4096
 #define LZW_MAX_CODE (LZW_DICT_SIZE - 1)
+#define LZW_MIN_CODE_WIDTH 9
+#define LZW_MAX_CODE_WIDTH 12
 
+#define LZW_STREAM_MAGIC "LZW"
+#define LZW_STREAM_VERSION 1
+
+// Cabecera del flujo comprimido; le siguen los códigos empaquetados en bits
+// (LSB primero), de 9 a 12 bits según crece el diccionario
 typedef struct {
-    uint16_t next[256];
-    uint8_t value;
-} LZWDictEntry;
+    char magic[3];
+    uint8_t version;
+    uint32_t reserved;
+    uint64_t original_size;
+    uint64_t num_codes;
+} LZWStreamHeader;
+
+// Diccionario del compresor: tabla abierta (prefijo, byte) -> código.
+// Cada ranura empaqueta la clave de 20 bits y el código de 12 bits;
+// 0 marca ranura libre porque ningún código nuevo vale 0
+#define LZW_HASH_BITS 13
+#define LZW_HASH_SIZE (1u << LZW_HASH_BITS)
 
 typedef struct {
-    LZWDictEntry entries[LZW_DICT_SIZE];
+    uint32_t slots[LZW_HASH_SIZE];
     uint16_t size;
 } LZWDictionary;
 
+#define LZW_CHAIN_MAX 16
+
+// Codificador incremental: init, feed con trozos de cualquier tamaño, finish
+#define LZW_ENCODER_INITIAL_CAPACITY 4096
+#define LZW_STREAM_BUFFER (64 * 1024)
+
+typedef struct {
+    LZWDictionary dict;
+    LZWStreamHeader header;
+    uint8_t *output;            // Cabecera + códigos empaquetados
+    size_t capacity;
+    size_t pos;
+    uint64_t acc;
+    unsigned bits;
+    uint16_t current_code;
+    int has_code;
+} LZWEncoder;
+
+// Destino de la decodificación en streaming: recibe trozos de como mucho
+// LZW_SINK_WINDOW bytes y devuelve 0 para continuar
+#define LZW_SINK_WINDOW (64 * 1024)
+
+typedef int (*LZWSink)(const uint8_t *data, size_t size, void *ctx);
+
+// Tablas planas de decodificación: cada código es prefijo + byte final.
+// offset guarda dónde apareció la cadena por primera vez en la salida
+typedef struct {
+    uint16_t prefix[LZW_DICT_SIZE];
+    uint8_t suffix[LZW_DICT_SIZE];
+    uint16_t length[LZW_DICT_SIZE];
+    size_t offset[LZW_DICT_SIZE];
+} LZWDecodeTable;
+
+unsigned lzw_code_width(size_t dict_size);
 uint8_t* lzw_compress(const uint8_t *input, size_t input_size, size_t *output_size);
+int lzw_compress_into(const uint8_t *input, size_t input_size,
+                      uint8_t *output, size_t output_capacity, size_t *output_size);
 uint8_t* lzw_decompress(const uint8_t *input, size_t input_size, size_t *output_size);
+int lzw_encoder_init(LZWEncoder *enc);
+int lzw_encoder_feed(LZWEncoder *enc, const uint8_t *data, size_t size);
+uint8_t* lzw_encoder_finish(LZWEncoder *enc, size_t *output_size);
+void lzw_encoder_free(LZWEncoder *enc);
+void lzw_decode_table_init(LZWDecodeTable *table);
+uint8_t* lzw_decompress_with(LZWDecodeTable *table, const uint8_t *input,
+                             size_t input_size, size_t *output_size);
+int lzw_decompress_into(const uint8_t *input, size_t input_size,
+                        uint8_t *output, size_t output_size);
+int lzw_decompress_to_sink(const uint8_t *input, size_t input_size, LZWSink sink, void *ctx);
 int compress_file(const char *filename, uint8_t **compressed_data, size_t *compressed_size);
 int decompress_to_file(const char *filename, const uint8_t *compressed_data, size_t compressed_size);
 
@@ -1,6 +1,7 @@
 
 #define _POSIX_C_SOURCE 200809L
 #include "filesystem.h"
+#include "workqueue.h"
 #include <stdio.h>
 #include <dirent.h>
 #include <sys/stat.h>
@@ -9,17 +10,205 @@
 #include <stdlib.h>
 #include <limits.h>
 #include <errno.h>
+#include <pthread.h>
 
-int load_files_into_system(BattleFS *fs, const char *dir_path) {
+#define INGEST_QUEUE_DEPTH 64
+
+// Trabajo que recorre el pipeline lector -> compresores -> inserción
+typedef struct {
+    char *path;
+    FileEntry *entry;
+} IngestJob;
+
+typedef struct {
+    DIR *dir;
+    const char *full_path;
+    CodecId codec;
+    WorkQueue pending;
+    WorkQueue done;
+    int active_workers;
+    pthread_mutex_t lock;
+} IngestPipeline;
+
+// Entradas comprimidas que se insertan juntas al terminar el directorio
+typedef struct {
+    char **names;
+    FileEntry **entries;
+    size_t count;
+    size_t capacity;
+} IngestBatch;
+
+// Toma la ruta y la entrada; si no hay memoria para el lote, inserta ya
+static int batch_add(BattleFS *fs, IngestBatch *batch, char *path, FileEntry *entry) {
+    if (batch->count == batch->capacity) {
+        size_t new_capacity = batch->capacity ? batch->capacity * 2 : 64;
+        char **names = realloc(batch->names, new_capacity * sizeof(*names));
+        if (names) batch->names = names;
+        FileEntry **entries = names ? realloc(batch->entries, new_capacity * sizeof(*entries)) : NULL;
+        if (entries) batch->entries = entries;
+        if (!names || !entries) {
+            int inserted = battlefs_insert(fs, path, entry) == 0;
+            if (!inserted) battlefs_entry_free(entry);
+            free(path);
+            return inserted;
+        }
+        batch->capacity = new_capacity;
+    }
+    batch->names[batch->count] = path;
+    batch->entries[batch->count] = entry;
+    batch->count++;
+    return 0;
+}
+
+static int batch_commit(BattleFS *fs, IngestBatch *batch) {
+    int inserted = battlefs_insert_batch(fs, batch->names, batch->entries, batch->count);
+    for (size_t i = 0; i < batch->count; i++) {
+        free(batch->names[i]);
+    }
+    free(batch->names);
+    free(batch->entries);
+    return inserted > 0 ? inserted : 0;
+}
+
+static void* ingest_reader(void *arg) {
+    IngestPipeline *pipe = arg;
+    struct dirent *ent;
+    struct stat st;
+
+    while ((ent = readdir(pipe->dir)) != NULL) {
+        if (strcmp(ent->d_name, ".") == 0 || strcmp(ent->d_name, "..") == 0) {
+            continue;
+        }
+
+        char file_path[PATH_MAX * 2];
+        snprintf(file_path, sizeof(file_path), "%s/%s", pipe->full_path, ent->d_name);
+        if (stat(file_path, &st) != 0 || !S_ISREG(st.st_mode)) continue;
+
+        IngestJob *job = calloc(1, sizeof(IngestJob));
+        if (!job) break;
+        job->path = strdup(file_path);
+        if (!job->path || workqueue_push(&pipe->pending, job) != 0) {
+            free(job->path);
+            free(job);
+            break;
+        }
+    }
+
+    workqueue_close(&pipe->pending);
+    return NULL;
+}
+
+// El último en soltar su referencia cierra la cola de resultados
+static void pipeline_release(IngestPipeline *pipe) {
+    pthread_mutex_lock(&pipe->lock);
+    int last = --pipe->active_workers == 0;
+    pthread_mutex_unlock(&pipe->lock);
+    if (last) workqueue_close(&pipe->done);
+}
+
+static void* ingest_worker(void *arg) {
+    IngestPipeline *pipe = arg;
+    IngestJob *job;
+
+    while ((job = workqueue_pop(&pipe->pending)) != NULL) {
+        printf("Procesando: %s\n", strrchr(job->path, '/') + 1);
+        job->entry = battlefs_compress_file(job->path, 1, pipe->codec);
+        workqueue_push(&pipe->done, job);
+    }
+
+    pipeline_release(pipe);
+    return NULL;
+}
+
+// Un hilo lector recorre el directorio, num_threads hilos comprimen y el
+// hilo llamante es el único que toca el árbol, con todo el lote al final
+static int load_parallel(BattleFS *fs, DIR *dir, const char *full_path, int num_threads) {
+    IngestPipeline pipe;
+    pipe.dir = dir;
+    pipe.full_path = full_path;
+    pipe.codec = fs->codec;
+    // El hilo llamante guarda una referencia mientras arranca compresores,
+    // para que los primeros no cierren la cola de resultados al terminar
+    pipe.active_workers = 1;
+    pthread_mutex_init(&pipe.lock, NULL);
+
+    if (workqueue_init(&pipe.pending, INGEST_QUEUE_DEPTH) != 0) {
+        pthread_mutex_destroy(&pipe.lock);
+        return -1;
+    }
+    if (workqueue_init(&pipe.done, INGEST_QUEUE_DEPTH) != 0) {
+        workqueue_destroy(&pipe.pending);
+        pthread_mutex_destroy(&pipe.lock);
+        return -1;
+    }
+
+    pthread_t reader;
+    pthread_t *workers = calloc(num_threads, sizeof(pthread_t));
+    if (!workers || pthread_create(&reader, NULL, ingest_reader, &pipe) != 0) {
+        free(workers);
+        workqueue_destroy(&pipe.pending);
+        workqueue_destroy(&pipe.done);
+        pthread_mutex_destroy(&pipe.lock);
+        return -1;
+    }
+
+    int started = 0;
+    for (; started < num_threads; started++) {
+        pthread_mutex_lock(&pipe.lock);
+        pipe.active_workers++;
+        pthread_mutex_unlock(&pipe.lock);
+        if (pthread_create(&workers[started], NULL, ingest_worker, &pipe) != 0) {
+            pipeline_release(&pipe);
+            break;
+        }
+    }
+    // Sin compresores: drenar lo que ya leyó el lector
+    if (started == 0) workqueue_close(&pipe.pending);
+    pipeline_release(&pipe);
+
+    int loaded_files = 0;
+    IngestBatch batch = {0};
+    IngestJob *job;
+    while ((job = workqueue_pop(&pipe.done)) != NULL) {
+        if (job->entry) {
+            loaded_files += batch_add(fs, &batch, job->path, job->entry);
+        } else {
+            fprintf(stderr, "Error al cargar: %s\n", strrchr(job->path, '/') + 1);
+            free(job->path);
+        }
+        free(job);
+    }
+    loaded_files += batch_commit(fs, &batch);
+
+    pthread_join(reader, NULL);
+    for (int i = 0; i < started; i++) {
+        pthread_join(workers[i], NULL);
+    }
+
+    // Trabajos que el lector dejó si no hubo compresores
+    while ((job = workqueue_pop(&pipe.pending)) != NULL) {
+        free(job->path);
+        free(job);
+    }
+
+    free(workers);
+    workqueue_destroy(&pipe.pending);
+    workqueue_destroy(&pipe.done);
+    pthread_mutex_destroy(&pipe.lock);
+    return loaded_files;
+}
+
+int load_files_into_system(BattleFS *fs, const char *dir_path, int num_threads) {
     DIR *dir;
     struct dirent *ent;
     int loaded_files = 0;
     char full_path[PATH_MAX];
     
     // Construir ruta completa manualmente
+    int length;
     if (dir_path[0] == '/') {
         // Ruta absoluta
-        strncpy(full_path, dir_path, sizeof(full_path));
+        length = snprintf(full_path, sizeof(full_path), "%s", dir_path);
     } else {
         // Ruta relativa - agregar al directorio actual
         char cwd[PATH_MAX];
@@ -27,7 +216,11 @@ int load_files_into_system(BattleFS *fs, const char *dir_path) {
             perror("Error al obtener directorio actual");
             return -1;
         }
-        snprintf(full_path, sizeof(full_path), "%s/%s", cwd, dir_path);
+        length = snprintf(full_path, sizeof(full_path), "%s/%s", cwd, dir_path);
+    }
+    if (length < 0 || (size_t)length >= sizeof(full_path)) {
+        fprintf(stderr, "Error: Ruta demasiado larga: '%s'\n", dir_path);
+        return -1;
     }
 
     // Eliminar barras duplicadas (opcional pero recomendado)
@@ -51,6 +244,13 @@ int load_files_into_system(BattleFS *fs, const char *dir_path) {
         return -1;
     }
 
+    if (num_threads > 1) {
+        loaded_files = load_parallel(fs, dir, full_path, num_threads);
+        closedir(dir);
+        return loaded_files;
+    }
+
+    IngestBatch batch = {0};
     while ((ent = readdir(dir)) != NULL) {
         if (strcmp(ent->d_name, ".") == 0 || strcmp(ent->d_name, "..") == 0) {
             continue;
@@ -61,14 +261,17 @@ int load_files_into_system(BattleFS *fs, const char *dir_path) {
         
         if (stat(file_path, &st) == 0 && S_ISREG(st.st_mode)) {
             printf("Procesando: %s\n", ent->d_name);
-            if (battlefs_create(fs, file_path) == 0) {
-                loaded_files++;
+            FileEntry *entry = battlefs_compress_file(file_path, fs->compress_threads, fs->codec);
+            char *path = entry ? strdup(file_path) : NULL;
+            if (path) {
+                loaded_files += batch_add(fs, &batch, path, entry);
             } else {
+                battlefs_entry_free(entry);
                 fprintf(stderr, "Error al cargar: %s\n", ent->d_name);
             }
         }
     }
     
     closedir(dir);
-    return loaded_files;
+    return loaded_files + batch_commit(fs, &batch);
 }
\ No newline at end of file
@@ -1,22 +1,44 @@
 
 #define _POSIX_C_SOURCE 200809L
 #include "filesystem.h"
+#include "image.h"
+#include "journal.h"
+#include "xxhash64.h"
+#include "codec.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
 #include <sys/stat.h>
 
+// Reparto de bloques entre hilos: cada hilo toma el siguiente índice libre
+typedef struct {
+    const uint8_t *data;
+    size_t size;
+    size_t chunk_size;
+    size_t num_chunks;
+    CodecId codec;
+    CodecStats *stats;          // Uno por bloque en modo automático
+    uint8_t **outputs;
+    size_t *output_sizes;
+    atomic_size_t next;
+    atomic_int failed;
+} ChunkJob;
+
 static void print_entry(const char *filename, void *value) {
     FileEntry *entry = (FileEntry*)value;
-    printf("- %s (%zu bytes -> %zu bytes)\n", 
-           filename, entry->original_size, entry->compressed_size);
+    printf("- %s (%zu bytes -> %zu bytes, %s)\n", 
+           filename, entry->original_size, entry->compressed_size, codec_name(entry->codec));
 }
 
 static void free_entry(const char *filename, void *value) {
     (void)filename;
-    FileEntry *entry = (FileEntry*)value;
-    free(entry->compressed_data);
-    free(entry);
+    battlefs_entry_release((FileEntry*)value);
 }
 
 BattleFS* battlefs_init(const char *name) {
@@ -37,145 +59,1364 @@ BattleFS* battlefs_init(const char *name) {
         free(fs);
         return NULL;
     }
+
+    fs->cache = block_cache_init(BATTLEFS_CACHE_BUDGET);
+    if (!fs->cache) {
+        bplus_tree_free(fs->index);
+        free(fs->name);
+        free(fs);
+        return NULL;
+    }
+
+    fs->journal = journal_init();
+    if (!fs->journal) {
+        block_cache_free(fs->cache);
+        bplus_tree_free(fs->index);
+        free(fs->name);
+        free(fs);
+        return NULL;
+    }
+
+    // Sin memoria para la tabla se sigue solo con el árbol
+    fs->lookup = BATTLEFS_HASH_INDEX ? hash_index_init() : NULL;
+    // Y sin la de blobs, sin deduplicar
+    fs->blobs = BATTLEFS_DEDUP ? hash_index_init() : NULL;
+    pthread_rwlock_init(&fs->lock, NULL);
+    pthread_rwlock_init(&fs->staging_lock, NULL);
+    pthread_mutex_init(&fs->map_lock, NULL);
+    pthread_cond_init(&fs->map_idle, NULL);
+    pthread_mutex_init(&fs->persist_lock, NULL);
+    pthread_mutex_init(&fs->compact_lock, NULL);
+    atomic_init(&fs->image_size, 0);
+    atomic_init(&fs->compacting, 0);
     
-    fs->total_files = 0;
-    fs->total_compressed_size = 0;
-    fs->total_original_size = 0;
+    atomic_init(&fs->total_files, 0);
+    atomic_init(&fs->total_compressed_size, 0);
+    atomic_init(&fs->total_original_size, 0);
+    atomic_init(&fs->stored_compressed_size, 0);
+
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    fs->compress_threads = cpus > 0 ? (int)cpus : 1;
+    fs->codec = BATTLEFS_CODEC;
     
     return fs;
 }
 
-int battlefs_create(BattleFS *fs, const char *filename) {
-    if (!fs || !filename) return -1;
+// Entrada en construcción: datos y tabla de bloques crecen por duplicación;
+// el hash de contenido se calcula sobre lo leído
+typedef struct {
+    FileEntry *entry;
+    size_t data_capacity;
+    size_t table_capacity;
+    size_t stored_chunks;       // Bloques que el códec no logró reducir
+    CodecStats stats;
+    XXH64State hash;
+} EntryBuilder;
 
-    if (bplus_tree_search(fs->index, filename)) {
-        fprintf(stderr, "Error: Archivo ya existe\n");
+static int builder_append(EntryBuilder *builder, const uint8_t *data, size_t size,
+                          size_t original_size) {
+    FileEntry *entry = builder->entry;
+
+    if (entry->num_chunks + 2 > builder->table_capacity) {
+        size_t capacity = builder->table_capacity ? builder->table_capacity * 2 : 8;
+        uint64_t *table = realloc(entry->chunk_offsets, capacity * sizeof(uint64_t));
+        if (!table) return -1;
+        entry->chunk_offsets = table;
+        builder->table_capacity = capacity;
+    }
+
+    if (entry->compressed_size + size > builder->data_capacity) {
+        size_t capacity = builder->data_capacity ? builder->data_capacity * 2 : size;
+        if (capacity < entry->compressed_size + size) capacity = entry->compressed_size + size;
+        uint8_t *buffer = realloc(entry->compressed_data, capacity);
+        if (!buffer) return -1;
+        entry->compressed_data = buffer;
+        builder->data_capacity = capacity;
+    }
+
+    if (codec_block_id(data, size) == CODEC_STORED) builder->stored_chunks++;
+    memcpy(entry->compressed_data + entry->compressed_size, data, size);
+    entry->chunk_offsets[entry->num_chunks] = entry->compressed_size;
+    entry->compressed_size += size;
+    entry->num_chunks++;
+    entry->chunk_offsets[entry->num_chunks] = entry->compressed_size;
+    entry->original_size += original_size;
+    return 0;
+}
+
+// Lee hasta size bytes salvo fin de datos; admite tuberías y lecturas cortas
+static ssize_t read_full(int fd, uint8_t *buffer, size_t size) {
+    size_t filled = 0;
+    while (filled < size) {
+        ssize_t n = read(fd, buffer + filled, size - filled);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        if (n == 0) break;
+        filled += (size_t)n;
+    }
+    return (ssize_t)filled;
+}
+
+// En modo automático la decisión queda anotada en stats
+static uint8_t* encode_chunk(CodecId codec, const uint8_t *data, size_t size,
+                             size_t *compressed_size, CodecStats *stats) {
+    return codec == CODEC_AUTO ? codec_encode_auto(data, size, compressed_size, stats)
+                               : codec_encode(codec, data, size, compressed_size);
+}
+
+static int append_chunk(EntryBuilder *builder, CodecId codec, const uint8_t *data,
+                        size_t size) {
+    size_t compressed_size;
+    uint8_t *compressed = encode_chunk(codec, data, size, &compressed_size, &builder->stats);
+    if (!compressed) return -1;
+
+    int status = builder_append(builder, compressed, compressed_size, size);
+    free(compressed);
+    return status;
+}
+
+// Un solo hilo: se lee bloque a bloque y cada uno se comprime entero
+static int compress_stream(EntryBuilder *builder, int fd, CodecId codec) {
+    uint8_t *buffer = malloc(BATTLEFS_CHUNK_SIZE);
+    if (!buffer) return -1;
+
+    int status = 0;
+    while (status == 0) {
+        ssize_t n = read_full(fd, buffer, BATTLEFS_CHUNK_SIZE);
+        if (n <= 0) {
+            if (n < 0) status = -1;
+            break;
+        }
+        xxh64_update(&builder->hash, buffer, (size_t)n);
+        status = append_chunk(builder, codec, buffer, (size_t)n);
+        if ((size_t)n < BATTLEFS_CHUNK_SIZE) break;
+    }
+
+    free(buffer);
+    return status;
+}
+
+static void* compress_chunks_worker(void *arg) {
+    ChunkJob *job = arg;
+    size_t i;
+
+    while ((i = atomic_fetch_add(&job->next, 1)) < job->num_chunks) {
+        size_t start = i * job->chunk_size;
+        size_t len = job->size - start < job->chunk_size ? job->size - start : job->chunk_size;
+        job->outputs[i] = encode_chunk(job->codec, job->data + start, len,
+                                       &job->output_sizes[i], &job->stats[i]);
+        if (!job->outputs[i]) atomic_store(&job->failed, 1);
+    }
+    return NULL;
+}
+
+// Comprime una tanda de bloques entre num_threads hilos (el llamante
+// incluido) y los añade en orden a la entrada
+static int compress_batch(EntryBuilder *builder, const uint8_t *data, size_t size,
+                          int num_threads, CodecId codec) {
+    size_t num_chunks = (size + BATTLEFS_CHUNK_SIZE - 1) / BATTLEFS_CHUNK_SIZE;
+
+    ChunkJob job;
+    job.data = data;
+    job.size = size;
+    job.chunk_size = BATTLEFS_CHUNK_SIZE;
+    job.num_chunks = num_chunks;
+    job.codec = codec;
+    job.stats = calloc(num_chunks, sizeof(CodecStats));
+    job.outputs = calloc(num_chunks, sizeof(uint8_t*));
+    job.output_sizes = calloc(num_chunks, sizeof(size_t));
+    atomic_init(&job.next, 0);
+    atomic_init(&job.failed, 0);
+
+    if (!job.stats || !job.outputs || !job.output_sizes) {
+        free(job.stats);
+        free(job.outputs);
+        free(job.output_sizes);
         return -1;
     }
 
-    FILE *file = fopen(filename, "rb");
-    if (!file) {
+    size_t extra = (size_t)(num_threads > 1 ? num_threads - 1 : 0);
+    if (extra > num_chunks - 1) extra = num_chunks - 1;
+    pthread_t *threads = extra ? calloc(extra, sizeof(pthread_t)) : NULL;
+    size_t started = 0;
+    for (; threads && started < extra; started++) {
+        if (pthread_create(&threads[started], NULL, compress_chunks_worker, &job) != 0) break;
+    }
+    compress_chunks_worker(&job);
+    for (size_t i = 0; i < started; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    free(threads);
+
+    int status = atomic_load(&job.failed) ? -1 : 0;
+    for (size_t i = 0; i < num_chunks; i++) {
+        if (status == 0) {
+            size_t start = i * BATTLEFS_CHUNK_SIZE;
+            size_t len = size - start < BATTLEFS_CHUNK_SIZE ? size - start : BATTLEFS_CHUNK_SIZE;
+            status = builder_append(builder, job.outputs[i], job.output_sizes[i], len);
+            codec_stats_add(&builder->stats, &job.stats[i]);
+        }
+        free(job.outputs[i]);
+    }
+    free(job.stats);
+    free(job.outputs);
+    free(job.output_sizes);
+    return status;
+}
+
+// Varios hilos: se leen tandas de num_threads bloques y se comprimen a la vez,
+// así la memoria depende de los hilos y no del tamaño del archivo
+static int compress_stream_parallel(EntryBuilder *builder, int fd, int num_threads,
+                                    CodecId codec) {
+    size_t batch_size = (size_t)num_threads * BATTLEFS_CHUNK_SIZE;
+    uint8_t *batch = malloc(batch_size);
+    if (!batch) return -1;
+
+    int status = 0;
+    for (;;) {
+        ssize_t n = read_full(fd, batch, batch_size);
+        if (n <= 0) {
+            if (n < 0) status = -1;
+            break;
+        }
+        xxh64_update(&builder->hash, batch, (size_t)n);
+        status = compress_batch(builder, batch, (size_t)n, num_threads, codec);
+        if (status != 0 || (size_t)n < batch_size) break;
+    }
+
+    free(batch);
+    return status;
+}
+
+// Bytes originales del bloque: chunk_size salvo en el último
+static size_t chunk_length(const FileEntry *entry, size_t chunk) {
+    size_t offset = chunk * entry->chunk_size;
+    return entry->original_size - offset < entry->chunk_size
+           ? entry->original_size - offset : entry->chunk_size;
+}
+
+uint8_t* battlefs_decompress_chunk(const FileEntry *entry, size_t chunk, size_t *size) {
+    if (!entry || !size || chunk >= entry->num_chunks) return NULL;
+
+    uint64_t start = entry->chunk_offsets[chunk];
+    uint64_t end = entry->chunk_offsets[chunk + 1];
+    if (start > end || end > entry->compressed_size) return NULL;
+
+    size_t expected = chunk_length(entry, chunk);
+    uint8_t *data = malloc(expected ? expected : 1);
+    if (!data) return NULL;
+
+    if (codec_decode(entry->compressed_data + start, end - start, data, expected) != 0) {
+        free(data);
+        return NULL;
+    }
+    *size = expected;
+    return data;
+}
+
+// Comprime todo lo que se lea de fd sin conocer su tamaño de antemano
+FileEntry* battlefs_compress_fd(int fd, int num_threads, CodecId codec) {
+    FileEntry *entry = calloc(1, sizeof(FileEntry));
+    if (!entry) return NULL;
+    entry->chunk_size = BATTLEFS_CHUNK_SIZE;
+    atomic_init(&entry->refs, 1);
+
+    if (codec != CODEC_AUTO && !codec_get(codec)) codec = BATTLEFS_CODEC;
+    EntryBuilder builder = { entry, 0, 0, 0, {{0}, 0, 0, 0, 0}, {0} };
+    xxh64_init(&builder.hash, 0);
+    int status = num_threads > 1 ? compress_stream_parallel(&builder, fd, num_threads, codec)
+                                 : compress_stream(&builder, fd, codec);
+
+    if (status != 0 || entry->original_size == 0) {
+        battlefs_entry_free(entry);
+        return NULL;
+    }
+    entry->content_hash = xxh64_digest(&builder.hash);
+    entry->codec = builder.stored_chunks == entry->num_chunks || codec == CODEC_AUTO
+                   ? CODEC_STORED : codec;
+    entry->sampling = builder.stats;
+    // En modo automático, el códec que redujo más bloques
+    for (int i = 0; codec == CODEC_AUTO && i < CODEC_COUNT; i++) {
+        if (i != CODEC_STORED && builder.stats.chunks[i] > 0 &&
+            (entry->codec == CODEC_STORED ||
+             builder.stats.chunks[i] > builder.stats.chunks[entry->codec])) {
+            entry->codec = i;
+        }
+    }
+
+    // Ajustar el buffer de datos al tamaño final
+    uint8_t *data = realloc(entry->compressed_data, entry->compressed_size);
+    if (data) entry->compressed_data = data;
+    return entry;
+}
+
+// Lee y comprime un archivo sin tocar el sistema; seguro entre hilos
+FileEntry* battlefs_compress_file(const char *filename, int num_threads, CodecId codec) {
+    if (!filename) return NULL;
+
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0) {
         perror("Error al abrir archivo");
-        return -1;
+        return NULL;
     }
 
-    fseek(file, 0, SEEK_END);
-    long file_size = ftell(file);
-    fseek(file, 0, SEEK_SET);
+    FileEntry *entry = battlefs_compress_fd(fd, num_threads, codec);
+    close(fd);
+    return entry;
+}
+
+// Búsqueda exacta: por la tabla hash si está activa, si no por el árbol.
+// Requiere el cerrojo del sistema en cualquier modo
+static FileEntry* find_entry(BattleFS *fs, const char *filename) {
+    if (fs->lookup) return hash_index_get(fs->lookup, filename);
+    return bplus_tree_search(fs->index, filename);
+}
 
-    if (file_size <= 0) {
-        fclose(file);
+// Marca una lectura en curso; espera si la compactación cambia de mapeo
+static void map_enter(BattleFS *fs) {
+    pthread_mutex_lock(&fs->map_lock);
+    while (fs->remapping) pthread_cond_wait(&fs->map_idle, &fs->map_lock);
+    fs->map_readers++;
+    pthread_mutex_unlock(&fs->map_lock);
+}
+
+static void map_leave(BattleFS *fs) {
+    pthread_mutex_lock(&fs->map_lock);
+    if (--fs->map_readers == 0 && fs->remapping) pthread_cond_broadcast(&fs->map_idle);
+    pthread_mutex_unlock(&fs->map_lock);
+}
+
+// Entrada con una referencia para el llamante, que la suelta con
+// release_entry; el cerrojo solo dura la búsqueda
+static FileEntry* acquire_entry(BattleFS *fs, const char *filename) {
+    map_enter(fs);
+    pthread_rwlock_rdlock(&fs->lock);
+    FileEntry *entry = find_entry(fs, filename);
+    if (entry) atomic_fetch_add_explicit(&entry->refs, 1, memory_order_relaxed);
+    pthread_rwlock_unlock(&fs->lock);
+
+    if (!entry) {
+        map_leave(fs);
+        fprintf(stderr, "Error: Archivo no encontrado\n");
+    }
+    return entry;
+}
+
+static void release_entry(BattleFS *fs, FileEntry *entry) {
+    battlefs_entry_release(entry);
+    map_leave(fs);
+}
+
+static int contains_entry(BattleFS *fs, const char *filename) {
+    pthread_rwlock_rdlock(&fs->lock);
+    int found = find_entry(fs, filename) != NULL;
+    pthread_rwlock_unlock(&fs->lock);
+    return found;
+}
+
+// Hash de contenido y códec: el mismo contenido con otro códec son otros bytes
+#define BLOB_KEY_SIZE 19
+
+static void blob_key(uint64_t hash, CodecId codec, char key[BLOB_KEY_SIZE]) {
+    snprintf(key, BLOB_KEY_SIZE, "%016llx%02x", (unsigned long long)hash, (unsigned)codec);
+}
+
+// Mismo hash no basta: una colisión no debe mezclar archivos distintos
+static int same_content(const Blob *blob, const FileEntry *entry) {
+    if (blob->hash != entry->content_hash || blob->codec != entry->codec ||
+        blob->original_size != entry->original_size ||
+        blob->compressed_size != entry->compressed_size ||
+        blob->chunk_size != entry->chunk_size ||
+        blob->num_chunks != entry->num_chunks) {
+        return 0;
+    }
+    if (blob->compressed_data == entry->compressed_data) return 1;
+    return memcmp(blob->chunk_offsets, entry->chunk_offsets,
+                  (blob->num_chunks + 1) * sizeof(uint64_t)) == 0 &&
+           memcmp(blob->compressed_data, entry->compressed_data, blob->compressed_size) == 0;
+}
+
+// Blob ya presente con el contenido de entry; requiere el cerrojo
+static Blob* find_blob(BattleFS *fs, const FileEntry *entry) {
+    if (!fs->blobs) return NULL;
+
+    char key[BLOB_KEY_SIZE];
+    blob_key(entry->content_hash, entry->codec, key);
+    Blob *blob = hash_index_get(fs->blobs, key);
+    return blob && same_content(blob, entry) ? blob : NULL;
+}
+
+static void blob_release(Blob *blob) {
+    if (atomic_fetch_sub_explicit(&blob->refs, 1, memory_order_acq_rel) != 1) return;
+    if (!blob->mapped) {
+        free(blob->compressed_data);
+        free(blob->chunk_offsets);
+    }
+    free(blob);
+}
+
+// Blob dueño de los datos y la tabla de bloques de entry, sin publicar.
+// Con el cerrojo de escritura (reparte un id)
+static Blob* new_blob(BattleFS *fs, const FileEntry *entry) {
+    Blob *blob = calloc(1, sizeof(Blob));
+    if (!blob) return NULL;
+
+    blob->hash = entry->content_hash;
+    blob->codec = entry->codec;
+    blob->compressed_data = entry->compressed_data;
+    blob->compressed_size = entry->compressed_size;
+    blob->original_size = entry->original_size;
+    blob->chunk_size = entry->chunk_size;
+    blob->num_chunks = entry->num_chunks;
+    blob->chunk_offsets = entry->chunk_offsets;
+    blob->mapped = entry->mapped;
+    blob->id = ++fs->next_id;
+    atomic_init(&blob->refs, 1);
+    return blob;
+}
+
+// Lo cuenta como almacenado y lo hace visible para deduplicar. Ante una
+// colisión la tabla conserva el primero
+static void publish_blob(BattleFS *fs, Blob *blob) {
+    atomic_fetch_add_explicit(&fs->stored_compressed_size, blob->compressed_size,
+                              memory_order_relaxed);
+    char key[BLOB_KEY_SIZE];
+    blob_key(blob->hash, blob->codec, key);
+    if (fs->blobs && !hash_index_get(fs->blobs, key)) {
+        hash_index_put(fs->blobs, key, blob);
+    }
+}
+
+// La entrada pasa a usar el blob de su contenido: uno que ya existía (y
+// suelta sus propios datos) o uno nuevo que se queda con ellos. Sin memoria
+// para el blob la entrada sigue siendo dueña de sus datos
+static void share_blob(BattleFS *fs, FileEntry *entry) {
+    Blob *blob = find_blob(fs, entry);
+    if (blob) {
+        if (entry->compressed_data != blob->compressed_data && !entry->mapped) {
+            free(entry->compressed_data);
+            free(entry->chunk_offsets);
+        }
+        entry->compressed_data = blob->compressed_data;
+        entry->chunk_offsets = blob->chunk_offsets;
+        atomic_fetch_add_explicit(&blob->refs, 1, memory_order_relaxed);
+    } else {
+        blob = new_blob(fs, entry);
+        if (!blob) {
+            atomic_fetch_add_explicit(&fs->stored_compressed_size, entry->compressed_size,
+                                      memory_order_relaxed);
+            entry->id = ++fs->next_id;
+            return;
+        }
+        publish_blob(fs, blob);
+    }
+    blob->links++;
+    entry->blob = blob;
+    entry->id = blob->id;
+}
+
+// Suelta el nombre que usaba el blob de entry; el último lo saca de la tabla
+static void unshare_blob(BattleFS *fs, FileEntry *entry) {
+    Blob *blob = entry->blob;
+    if (blob && --blob->links > 0) return;
+
+    atomic_fetch_sub_explicit(&fs->stored_compressed_size, entry->compressed_size,
+                              memory_order_relaxed);
+    if (blob && fs->blobs) {
+        char key[BLOB_KEY_SIZE];
+        blob_key(blob->hash, blob->codec, key);
+        if (hash_index_get(fs->blobs, key) == blob) hash_index_remove(fs->blobs, key);
+    }
+}
+
+// Da de alta una entrada ya insertada en el árbol: blob compartido, tabla
+// hash y contadores. Con el cerrojo de escritura o antes de publicar el
+// sistema. Si la tabla hash no admite la entrada, se descarta entera
+void battlefs_register(BattleFS *fs, const char *filename, FileEntry *entry) {
+    share_blob(fs, entry);
+    codec_stats_add(&fs->sampling, &entry->sampling);
+    atomic_fetch_add_explicit(&fs->total_files, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&fs->total_compressed_size, entry->compressed_size,
+                              memory_order_relaxed);
+    atomic_fetch_add_explicit(&fs->total_original_size, entry->original_size,
+                              memory_order_relaxed);
+
+    if (!fs->lookup) return;
+    if (hash_index_put(fs->lookup, filename, entry) != 0) {
+        hash_index_free(fs->lookup);
+        fs->lookup = NULL;
+    }
+}
+
+// Primera mitad de una inserción, fuera del cerrojo de escritura y con
+// staging_lock compartido: si el contenido no está en el sistema, sus datos
+// van al diario como registro sin nombre. Devuelve 1 si quedan escritos (o
+// no hay diario), 0 si el contenido ya estaba y -1 si el nombre existe o
+// falla la escritura
+static int stage_entry(BattleFS *fs, const char *filename, const FileEntry *entry) {
+    pthread_rwlock_rdlock(&fs->lock);
+    int exists = find_entry(fs, filename) != NULL;
+    int stored = find_blob(fs, entry) != NULL;
+    pthread_rwlock_unlock(&fs->lock);
+
+    if (exists) {
+        fprintf(stderr, "Error: Archivo ya existe\n");
         return -1;
     }
+    if (!journal_active(fs->journal)) return 1;
+    if (stored) return 0;
+    return journal_append(fs->journal, JOURNAL_DATA, NULL, entry) == 0 ? 1 : -1;
+}
 
-    uint8_t *file_data = malloc(file_size);
-    if (!file_data) {
-        fclose(file);
+// Segunda mitad, con el cerrojo de escritura: el diario solo anota el
+// nombre, en el mismo orden en que cambia el índice. Si el contenido
+// desapareció desde stage_entry, sus datos se escriben aquí. Un registro
+// de datos que no llega a enlazarse no cambia nada al repetir el diario;
+// si falla el índice, un borrado anula el enlace
+static int insert_locked(BattleFS *fs, const char *filename, FileEntry *entry, int staged) {
+    if (find_entry(fs, filename)) {
+        fprintf(stderr, "Error: Archivo ya existe\n");
         return -1;
     }
+    if (!staged && !find_blob(fs, entry) &&
+        journal_append(fs->journal, JOURNAL_DATA, NULL, entry) != 0) {
+        return -1;
+    }
+    if (journal_append(fs->journal, JOURNAL_LINK, filename, entry) != 0) return -1;
 
-    if (fread(file_data, 1, file_size, file) != (size_t)file_size) {
-        free(file_data);
-        fclose(file);
+    if (bplus_tree_insert(fs->index, filename, entry) != 0) {
+        fprintf(stderr, "Error: Sin memoria para indexar '%s'\n", filename);
+        journal_append(fs->journal, JOURNAL_DELETE, filename, NULL);
         return -1;
     }
-    fclose(file);
+    battlefs_register(fs, filename, entry);
+    return 0;
+}
+
+// Quita el nombre del índice y devuelve la entrada con la referencia del
+// sistema, o NULL si no existe o si el árbol no tuvo memoria para
+// reequilibrarse (y entonces nada cambia)
+static FileEntry* unlink_locked(BattleFS *fs, const char *filename) {
+    FileEntry *entry = find_entry(fs, filename);
+    if (!entry) return NULL;
+
+    if (bplus_tree_delete(fs->index, filename) != 0) {
+        fprintf(stderr, "Error: Sin memoria para quitar '%s' del índice\n", filename);
+        return NULL;
+    }
+    hash_index_remove(fs->lookup, filename);
+    unshare_blob(fs, entry);
+    atomic_fetch_sub_explicit(&fs->total_files, 1, memory_order_relaxed);
+    atomic_fetch_sub_explicit(&fs->total_compressed_size, entry->compressed_size,
+                              memory_order_relaxed);
+    atomic_fetch_sub_explicit(&fs->total_original_size, entry->original_size,
+                              memory_order_relaxed);
+    return entry;
+}
 
-    size_t compressed_size;
-    uint8_t *compressed_data = lzw_compress(file_data, file_size, &compressed_size);
-    free(file_data);
-    if (!compressed_data) return -1;
+// Inserta una entrada ya comprimida; el sistema pasa a ser su dueño
+int battlefs_insert(BattleFS *fs, const char *filename, FileEntry *entry) {
+    if (!fs || !filename || !entry) return -1;
 
-    FileEntry *entry = malloc(sizeof(FileEntry));
-    if (!entry) {
-        free(compressed_data);
-        return -1;
+    pthread_rwlock_rdlock(&fs->staging_lock);
+    int staged = stage_entry(fs, filename, entry);
+    int status = -1;
+    if (staged >= 0) {
+        pthread_rwlock_wrlock(&fs->lock);
+        status = insert_locked(fs, filename, entry, staged);
+        pthread_rwlock_unlock(&fs->lock);
+    }
+    pthread_rwlock_unlock(&fs->staging_lock);
+
+    // El fsync agrupado va fuera del cerrojo del sistema
+    journal_commit(fs->journal, 0);
+    return status;
+}
+
+typedef struct {
+    const char *name;
+    FileEntry *entry;
+} BatchItem;
+
+static int compare_batch_items(const void *a, const void *b) {
+    return strcmp(((const BatchItem*)a)->name, ((const BatchItem*)b)->name);
+}
+
+// Con el cerrojo de escritura; staged es el resultado de stage_entry para
+// cada entrada, o NULL si no se preparó ninguna
+static int insert_each(BattleFS *fs, const char *const *filenames, void *const *entries,
+                       const int *staged, size_t count) {
+    int inserted = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (insert_locked(fs, filenames[i], entries[i], staged ? staged[i] : 0) == 0) {
+            inserted++;
+        } else {
+            battlefs_entry_free(entries[i]);
+        }
+    }
+    return inserted;
+}
+
+// Inserta un lote y se queda con todas sus entradas (libera las repetidas).
+// Con el sistema vacío construye el índice de una pasada; el lote se ordena
+// y sus datos van al diario antes de tomar el cerrojo
+int battlefs_insert_batch(BattleFS *fs, char **filenames, FileEntry **entries, size_t count) {
+    if (!fs || (count > 0 && (!filenames || !entries))) return -1;
+    if (count == 0) return 0;
+
+    BatchItem *items = malloc(count * sizeof(BatchItem));
+    const char **keys = malloc(count * sizeof(char*));
+    void **values = malloc(count * sizeof(void*));
+    int *staged = malloc(count * sizeof(int));
+    if (!items || !keys || !values || !staged) {
+        free(items);
+        free(keys);
+        free(values);
+        free(staged);
+        // Sin memoria: los datos se escriben con el cerrojo
+        pthread_rwlock_rdlock(&fs->staging_lock);
+        pthread_rwlock_wrlock(&fs->lock);
+        int inserted = insert_each(fs, (const char *const *)filenames,
+                                   (void *const *)entries, NULL, count);
+        pthread_rwlock_unlock(&fs->lock);
+        pthread_rwlock_unlock(&fs->staging_lock);
+        journal_commit(fs->journal, 0);
+        return inserted;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        items[i].name = filenames[i];
+        items[i].entry = entries[i];
+    }
+    qsort(items, count, sizeof(BatchItem), compare_batch_items);
+
+    pthread_rwlock_rdlock(&fs->staging_lock);
+    int journaled = journal_active(fs->journal);
+    size_t unique = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (unique > 0 && strcmp(items[i].name, keys[unique - 1]) == 0) {
+            fprintf(stderr, "Error: Archivo ya existe\n");
+            battlefs_entry_free(items[i].entry);
+            continue;
+        }
+        int status = journaled ? stage_entry(fs, items[i].name, items[i].entry) : 1;
+        if (status < 0) {
+            battlefs_entry_free(items[i].entry);
+            continue;
+        }
+        keys[unique] = items[i].name;
+        values[unique] = items[i].entry;
+        staged[unique] = status;
+        unique++;
+    }
+
+    // Con diario activo cada entrada necesita su registro: inserción normal
+    int inserted;
+    pthread_rwlock_wrlock(&fs->lock);
+    if (atomic_load(&fs->total_files) == 0 && !journaled &&
+        bplus_tree_bulk_load(fs->index, keys, values, unique) == 0) {
+        for (size_t i = 0; i < unique; i++) {
+            battlefs_register(fs, keys[i], values[i]);
+        }
+        inserted = (int)unique;
+    } else {
+        // Índice no vacío (o vaciado tras borrar todo): inserción normal
+        inserted = insert_each(fs, keys, values, staged, unique);
+    }
+    pthread_rwlock_unlock(&fs->lock);
+    pthread_rwlock_unlock(&fs->staging_lock);
+    journal_commit(fs->journal, 0);
+
+    free(items);
+    free(keys);
+    free(values);
+    free(staged);
+    return inserted;
+}
+
+// Para entradas que nunca llegaron al sistema; las demás se sueltan
+void battlefs_entry_free(FileEntry *entry) {
+    if (!entry) return;
+    if (entry->blob) {
+        blob_release(entry->blob);
+    } else if (!entry->mapped) {
+        free(entry->compressed_data);
+        free(entry->chunk_offsets);
     }
+    free(entry);
+}
+
+void battlefs_entry_release(FileEntry *entry) {
+    if (!entry) return;
+    if (atomic_fetch_sub_explicit(&entry->refs, 1, memory_order_acq_rel) == 1) {
+        battlefs_entry_free(entry);
+    }
+}
 
-    entry->compressed_data = compressed_data;
-    entry->compressed_size = compressed_size;
-    entry->original_size = file_size;
+// La compresión no toma el cerrojo: solo la comprobación y la inserción
+int battlefs_create(BattleFS *fs, const char *filename) {
+    if (!fs || !filename) return -1;
+
+    if (contains_entry(fs, filename)) {
+        fprintf(stderr, "Error: Archivo ya existe\n");
+        return -1;
+    }
 
-    bplus_tree_insert(fs->index, filename, entry);
-    fs->total_files++;
-    fs->total_compressed_size += compressed_size;
-    fs->total_original_size += file_size;
+    FileEntry *entry = battlefs_compress_file(filename, fs->compress_threads, fs->codec);
+    if (!entry) return -1;
 
+    if (battlefs_insert(fs, filename, entry) != 0) {
+        battlefs_entry_free(entry);
+        return -1;
+    }
     return 0;
 }
 
+// Bloque descomprimido a través de la caché, fijado: el llamante lo suelta
+// con block_cache_release
+static CacheBlock* load_chunk(BattleFS *fs, const FileEntry *entry, size_t chunk) {
+    CacheBlock *block = block_cache_get(fs->cache, entry->id, chunk);
+    if (block) return block;
+
+    size_t size;
+    uint8_t *data = battlefs_decompress_chunk(entry, chunk, &size);
+    return data ? block_cache_put(fs->cache, entry->id, chunk, data, size) : NULL;
+}
+
 int battlefs_read(BattleFS *fs, const char *filename) {
     if (!fs || !filename) return -1;
 
-    FileEntry *entry = bplus_tree_search(fs->index, filename);
-    if (!entry) {
-        fprintf(stderr, "Error: Archivo no encontrado\n");
+    FileEntry *entry = acquire_entry(fs, filename);
+    if (!entry) return -1;
+
+    // Descomprimir bloque a bloque para no materializar el archivo entero
+    int status = 0;
+    for (size_t i = 0; i < entry->num_chunks; i++) {
+        CacheBlock *block = load_chunk(fs, entry, i);
+        if (!block) {
+            status = -1;
+            break;
+        }
+
+        fwrite(block->data, 1, block->size, stdout);
+        block_cache_release(fs->cache, block);
+    }
+    release_entry(fs, entry);
+    return status;
+}
+
+// Solo descomprime los bloques que se solapan con [offset, offset + length)
+int battlefs_read_range(BattleFS *fs, const char *filename, size_t offset, size_t length) {
+    if (!fs || !filename) return -1;
+
+    FileEntry *entry = acquire_entry(fs, filename);
+    if (!entry) return -1;
+
+    if (offset > entry->original_size) {
+        fprintf(stderr, "Error: Desplazamiento fuera del archivo\n");
+        release_entry(fs, entry);
         return -1;
     }
+    if (length > entry->original_size - offset) {
+        length = entry->original_size - offset;
+    }
+
+    size_t end = offset + length;
+    size_t first = offset / entry->chunk_size;
+    size_t last = length ? (end - 1) / entry->chunk_size : 0;
+
+    int status = 0;
+    for (size_t i = first; length > 0 && i <= last; i++) {
+        CacheBlock *block = load_chunk(fs, entry, i);
+        if (!block) {
+            status = -1;
+            break;
+        }
+
+        size_t chunk_start = i * entry->chunk_size;
+        size_t from = offset > chunk_start ? offset - chunk_start : 0;
+        size_t to = end - chunk_start < block->size ? end - chunk_start : block->size;
+        fwrite(block->data + from, 1, to - from, stdout);
+        block_cache_release(fs->cache, block);
+    }
+    release_entry(fs, entry);
+    return status;
+}
+
+// Entrega el archivo al sink bloque a bloque: los bloques en caché salen de
+// ella y el resto se decodifica de uno en uno, nunca el archivo entero
+int battlefs_stream(BattleFS *fs, const char *filename, LZWSink sink, void *ctx) {
+    if (!fs || !filename || !sink) return -1;
+
+    FileEntry *entry = acquire_entry(fs, filename);
+    if (!entry) return -1;
+
+    int status = 0;
+    for (size_t i = 0; i < entry->num_chunks && status == 0; i++) {
+        CacheBlock *cached = block_cache_get(fs->cache, entry->id, i);
+        if (cached) {
+            if (sink(cached->data, cached->size, ctx) != 0) status = -1;
+            block_cache_release(fs->cache, cached);
+            continue;
+        }
+
+        uint64_t start = entry->chunk_offsets[i];
+        uint64_t end = entry->chunk_offsets[i + 1];
+        if (start > end || end > entry->compressed_size ||
+            codec_decode_to_sink(entry->compressed_data + start, end - start,
+                                 chunk_length(entry, i), sink, ctx) != 0) {
+            status = -1;
+        }
+    }
+    release_entry(fs, entry);
+    return status;
+}
 
-    size_t decompressed_size;
-    uint8_t *decompressed = lzw_decompress(entry->compressed_data, 
-                                         entry->compressed_size, 
-                                         &decompressed_size);
-    if (!decompressed) return -1;
+typedef struct {
+    int fd;
+    uint8_t *buffer;
+    size_t fill;
+} AlignedWriter;
 
-    fwrite(decompressed, 1, decompressed_size, stdout);
-    free(decompressed);
+static int write_all(int fd, const uint8_t *data, size_t size) {
+    while (size > 0) {
+        ssize_t n = write(fd, data, size);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        data += n;
+        size -= (size_t)n;
+    }
     return 0;
 }
 
+// Acumula trozos del decodificador y escribe en bloques grandes y alineados
+static int aligned_sink(const uint8_t *data, size_t size, void *ctx) {
+    AlignedWriter *writer = ctx;
+    while (size > 0) {
+        size_t take = BATTLEFS_WRITE_BUFFER - writer->fill;
+        if (take > size) take = size;
+        memcpy(writer->buffer + writer->fill, data, take);
+        writer->fill += take;
+        data += take;
+        size -= take;
+
+        if (writer->fill == BATTLEFS_WRITE_BUFFER) {
+            if (write_all(writer->fd, writer->buffer, writer->fill) != 0) return -1;
+            writer->fill = 0;
+        }
+    }
+    return 0;
+}
+
+int battlefs_extract(BattleFS *fs, const char *filename, const char *dest_path) {
+    if (!fs || !filename || !dest_path) return -1;
+
+    AlignedWriter writer = { -1, NULL, 0 };
+    void *buffer;
+    if (posix_memalign(&buffer, BATTLEFS_WRITE_ALIGN, BATTLEFS_WRITE_BUFFER) != 0) return -1;
+    writer.buffer = buffer;
+
+    writer.fd = open(dest_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (writer.fd < 0) {
+        perror("Error al crear destino");
+        free(buffer);
+        return -1;
+    }
+
+    int status = battlefs_stream(fs, filename, aligned_sink, &writer);
+    if (status == 0 && writer.fill > 0) {
+        status = write_all(writer.fd, writer.buffer, writer.fill);
+    }
+    if (close(writer.fd) != 0) status = -1;
+    free(buffer);
+
+    if (status != 0) unlink(dest_path);
+    return status;
+}
+
+// Lo que ocupan imagen y diario por encima de los datos vivos. Cuenta
+// también índice y cabeceras, que no se recuperan: es una estimación
+static uint64_t reclaimable_bytes(BattleFS *fs, uint64_t *on_disk) {
+    size_t image = atomic_load(&fs->image_size);
+    *on_disk = image ? image + journal_size(fs->journal) : 0;
+    size_t live = atomic_load(&fs->stored_compressed_size);
+    return *on_disk > live ? *on_disk - live : 0;
+}
+
+static void maybe_compact(BattleFS *fs) {
+    uint64_t on_disk;
+    uint64_t dead = reclaimable_bytes(fs, &on_disk);
+    if (dead >= BATTLEFS_COMPACT_MIN_BYTES && dead >= on_disk * BATTLEFS_COMPACT_RATIO &&
+        !atomic_load(&fs->compacting)) {
+        battlefs_compact_async(fs);
+    }
+}
+
 int battlefs_delete(BattleFS *fs, const char *filename) {
     if (!fs || !filename) return -1;
 
-    FileEntry *entry = bplus_tree_search(fs->index, filename);
-    if (!entry) {
+    pthread_rwlock_wrlock(&fs->lock);
+    if (!find_entry(fs, filename)) {
+        pthread_rwlock_unlock(&fs->lock);
         fprintf(stderr, "Error: Archivo no encontrado\n");
         return -1;
     }
+    if (journal_append(fs->journal, JOURNAL_DELETE, filename, NULL) != 0) {
+        pthread_rwlock_unlock(&fs->lock);
+        return -1;
+    }
+    FileEntry *entry = unlink_locked(fs, filename);
+    if (!entry) {
+        // El diario ya anota el borrado: se anula volviendo a enlazar los
+        // datos, que al repetirlo pueden haber salido ya de la tabla
+        FileEntry *current = find_entry(fs, filename);
+        journal_append(fs->journal, JOURNAL_DATA, NULL, current);
+        journal_append(fs->journal, JOURNAL_LINK, filename, current);
+        pthread_rwlock_unlock(&fs->lock);
+        return -1;
+    }
+    int last = !entry->blob || entry->blob->links == 0;
+    pthread_rwlock_unlock(&fs->lock);
+    journal_commit(fs->journal, 0);
+
+    // Las lecturas en curso conservan su referencia; la última libera. Los
+    // bloques en caché siguen sirviendo a otros archivos con el mismo blob
+    if (last) block_cache_invalidate(fs->cache, entry->id, entry->num_chunks);
+    battlefs_entry_release(entry);
+    maybe_compact(fs);
+    return 0;
+}
 
-    fs->total_files--;
-    fs->total_compressed_size -= entry->compressed_size;
-    fs->total_original_size -= entry->original_size;
+// La compactación en segundo plano en curso o la última terminada
+static void print_compaction(BattleFS *fs) {
+    if (atomic_load(&fs->compacting)) {
+        printf("Compactación: en curso\n");
+        return;
+    }
+    pthread_rwlock_rdlock(&fs->lock);
+    CompactStats stats = fs->compaction;
+    int compacted = fs->compacted;
+    pthread_rwlock_unlock(&fs->lock);
 
-    free(entry->compressed_data);
-    free(entry);
-    return bplus_tree_delete(fs->index, filename);
+    if (compacted < 0) {
+        printf("Última compactación: falló\n");
+    } else if (compacted > 0) {
+        uint64_t reclaimed = stats.bytes_before > stats.bytes_after
+                             ? stats.bytes_before - stats.bytes_after : 0;
+        printf("Última compactación: %zu archivos, %llu -> %llu bytes en disco "
+               "(%llu recuperados) en %.1f ms, %.1f MB/s\n",
+               stats.files, (unsigned long long)stats.bytes_before,
+               (unsigned long long)stats.bytes_after, (unsigned long long)reclaimed,
+               stats.seconds * 1e3,
+               stats.seconds > 0 ? stats.bytes_after / stats.seconds / (1024.0 * 1024.0) : 0.0);
+    }
+}
+
+// Qué eligió el modo automático y cuánto acertó con el tamaño
+static void print_sampling(BattleFS *fs) {
+    pthread_rwlock_rdlock(&fs->lock);
+    CodecStats stats = fs->sampling;
+    pthread_rwlock_unlock(&fs->lock);
+    if (stats.original_size == 0) return;
+
+    printf("Códec automático:");
+    for (int i = 0; i < CODEC_COUNT; i++) {
+        printf(" %s %u%s", codec_name(i), stats.chunks[i], i + 1 < CODEC_COUNT ? "," : "");
+    }
+    printf(" bloques (%u no redujeron con el elegido)\n", stats.fallbacks);
+    printf("  Estimado %llu bytes, real %llu de %llu (%.2f%% frente a %.2f%% del original)\n",
+           (unsigned long long)stats.estimated_size, (unsigned long long)stats.actual_size,
+           (unsigned long long)stats.original_size,
+           100.0 * stats.estimated_size / stats.original_size,
+           100.0 * stats.actual_size / stats.original_size);
 }
 
 void battlefs_list(BattleFS *fs) {
     if (!fs) return;
 
+    size_t total_files = atomic_load(&fs->total_files);
+    size_t total_original = atomic_load(&fs->total_original_size);
+    size_t total_compressed = atomic_load(&fs->total_compressed_size);
+
     printf("\n=== Sistema: %s ===\n", fs->name);
-    printf("Archivos totales: %zu\n", fs->total_files);
-    printf("Tamaño original: %zu bytes\n", fs->total_original_size);
-    printf("Tamaño comprimido: %zu bytes\n", fs->total_compressed_size);
+    printf("Archivos totales: %zu\n", total_files);
+    printf("Tamaño original: %zu bytes\n", total_original);
+    printf("Tamaño comprimido: %zu bytes\n", total_compressed);
     printf("Tasa de compresión: %.2f%%\n", 
-           (100.0 - (100.0 * fs->total_compressed_size / fs->total_original_size)));
+           (100.0 - (100.0 * total_compressed / total_original)));
+    size_t stored = atomic_load(&fs->stored_compressed_size);
+    printf("Deduplicación: %.2fx (%zu bytes comprimidos guardados una vez en %zu)\n",
+           stored ? (double)total_compressed / stored : 1.0, total_compressed, stored);
+    uint64_t on_disk;
+    uint64_t dead = reclaimable_bytes(fs, &on_disk);
+    if (on_disk > 0) {
+        printf("En disco: %llu bytes entre imagen y diario (~%llu recuperables con 'compact')\n",
+               (unsigned long long)on_disk, (unsigned long long)dead);
+    }
+    print_compaction(fs);
+    print_sampling(fs);
+    BlockCacheStats cache;
+    block_cache_stats(fs->cache, &cache);
+    printf("Caché: %llu aciertos, %llu fallos, %llu expulsiones (%zu/%zu bytes)\n",
+           (unsigned long long)cache.hits, (unsigned long long)cache.misses,
+           (unsigned long long)cache.evictions, cache.used_bytes, cache.budget_bytes);
     printf("\nContenido:\n");
+    pthread_rwlock_rdlock(&fs->lock);
     bplus_tree_list(fs->index, print_entry);
+    pthread_rwlock_unlock(&fs->lock);
+}
+
+static void print_match(const char *filename, void *value, void *ctx) {
+    (void)ctx;
+    print_entry(filename, value);
+}
+
+// Solo recorre las hojas que contienen el prefijo
+void battlefs_list_prefix(BattleFS *fs, const char *prefix) {
+    if (!fs || !prefix) return;
+
+    printf("\nContenido con prefijo '%s':\n", prefix);
+    pthread_rwlock_rdlock(&fs->lock);
+    int matches = bplus_tree_prefix(fs->index, prefix, print_match, NULL);
+    pthread_rwlock_unlock(&fs->lock);
+    printf("%d archivo(s)\n", matches);
 }
 
+#define JOURNAL_SUFFIX IMAGE_EXTENSION JOURNAL_EXTENSION
+
+static char* system_path(const char *system_name, const char *extension) {
+    size_t len = strlen(system_name) + strlen(extension) + 1;
+    char *path = malloc(len);
+    if (!path) return NULL;
+    snprintf(path, len, "%s%s", system_name, extension);
+    return path;
+}
+
+// Anota la imagen a la que corresponde el diario; con persist_lock o antes
+// de publicar el sistema
+static int remember_image(BattleFS *fs, const char *system_name, const char *path) {
+    struct stat st;
+    if (stat(path, &st) != 0) return -1;
+
+    if (system_name != fs->saved_name) {
+        char *name = strdup(system_name);
+        if (!name) return -1;
+        free(fs->saved_name);
+        fs->saved_name = name;
+    }
+    atomic_store(&fs->image_size, (size_t)st.st_size);
+    return 0;
+}
+
+// La imagen nueva ya contiene todo lo anotado: el diario empieza vacío.
+// Si se cae antes de vaciarlo, repetir sus registros sobre la imagen nueva
+// da el mismo resultado
 int battlefs_save(BattleFS *fs, const char *system_name) {
-    (void)fs;
-    (void)system_name;
-    printf("Funcionalidad de guardado no implementada aún\n");
+    if (!fs || !system_name) return -1;
+
+    char *path = system_path(system_name, IMAGE_EXTENSION);
+    char *journal = system_path(system_name, JOURNAL_SUFFIX);
+    if (!path || !journal) {
+        free(path);
+        free(journal);
+        return -1;
+    }
+
+    // Espera a las inserciones con datos en el diario aún sin enlazar: la
+    // imagen no las contiene y el diario nuevo tampoco tendría sus datos
+    pthread_mutex_lock(&fs->persist_lock);
+    pthread_rwlock_wrlock(&fs->staging_lock);
+    pthread_rwlock_rdlock(&fs->lock);
+    int status = image_write(fs, path);
+    if (status == 0) status = journal_attach(fs->journal, journal, 0);
+    pthread_rwlock_unlock(&fs->lock);
+    pthread_rwlock_unlock(&fs->staging_lock);
+    if (status == 0) status = remember_image(fs, system_name, path);
+    pthread_mutex_unlock(&fs->persist_lock);
+    free(path);
+    free(journal);
+    return status;
+}
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Reescribe la imagen con solo los blobs vivos, en orden de claves, sin
+// bloquear a nadie mientras escribe: la instantánea retiene sus entradas y
+// los cambios posteriores siguen en la cola del diario, que es lo único que
+// sobrevive al recortarlo
+int battlefs_compact(BattleFS *fs, CompactStats *stats) {
+    if (!fs || !stats) return -1;
+    memset(stats, 0, sizeof(*stats));
+
+    pthread_mutex_lock(&fs->persist_lock);
+    if (!fs->saved_name) {
+        pthread_mutex_unlock(&fs->persist_lock);
+        fprintf(stderr, "Error: El sistema no se ha guardado\n");
+        return -1;
+    }
+
+    char *path = system_path(fs->saved_name, IMAGE_EXTENSION);
+    char *journal = system_path(fs->saved_name, JOURNAL_SUFFIX);
+    int status = path && journal ? 0 : -1;
+    double start = now_seconds();
+    stats->bytes_before = atomic_load(&fs->image_size) + journal_size(fs->journal);
+
+    EntryList list;
+    uint64_t from = 0;
+    // Sin inserciones a medias, nada anterior a from hace falta después
+    if (status == 0) {
+        pthread_rwlock_wrlock(&fs->staging_lock);
+        pthread_rwlock_rdlock(&fs->lock);
+        status = image_snapshot(fs, &list);
+        from = journal_size(fs->journal);
+        pthread_rwlock_unlock(&fs->lock);
+        pthread_rwlock_unlock(&fs->staging_lock);
+    }
+    if (status == 0) {
+        stats->files = list.count;
+        status = image_write_entries(&list, path);
+        image_snapshot_free(&list);
+    }
+
+    // Con la imagen nueva en su sitio, repetir el diario entero daría lo
+    // mismo; recortarlo solo quita lo que ella ya contiene
+    if (status == 0) status = journal_rebase(fs->journal, journal, from);
+    if (status == 0) status = remember_image(fs, fs->saved_name, path);
+
+    // Mientras siga mapeada, la imagen vieja ocupa disco aunque ya no tenga
+    // nombre. Si no se puede cambiar de mapeo la compactación vale igual:
+    // el espacio se recupera al cargar el sistema
+    if (status == 0 && fs->map_base) {
+        pthread_mutex_lock(&fs->map_lock);
+        fs->remapping = 1;
+        while (fs->map_readers > 0) pthread_cond_wait(&fs->map_idle, &fs->map_lock);
+        pthread_mutex_unlock(&fs->map_lock);
+
+        pthread_rwlock_wrlock(&fs->staging_lock);
+        pthread_rwlock_wrlock(&fs->lock);
+        image_remap(fs, path);
+        pthread_rwlock_unlock(&fs->lock);
+        pthread_rwlock_unlock(&fs->staging_lock);
+
+        pthread_mutex_lock(&fs->map_lock);
+        fs->remapping = 0;
+        pthread_cond_broadcast(&fs->map_idle);
+        pthread_mutex_unlock(&fs->map_lock);
+    }
+
+    stats->bytes_after = atomic_load(&fs->image_size) + journal_size(fs->journal);
+    stats->seconds = now_seconds() - start;
+    pthread_mutex_unlock(&fs->persist_lock);
+    free(path);
+    free(journal);
+    return status;
+}
+
+// El resultado queda en el sistema para el listado: el hilo no escribe en
+// la consola mientras se usa
+static void* compact_thread(void *arg) {
+    BattleFS *fs = arg;
+    CompactStats stats;
+    int status = battlefs_compact(fs, &stats);
+
+    pthread_rwlock_wrlock(&fs->lock);
+    fs->compaction = stats;
+    fs->compacted = status == 0 ? 1 : -1;
+    pthread_rwlock_unlock(&fs->lock);
+    atomic_store(&fs->compacting, 0);
+    return NULL;
+}
+
+// Lanza la compactación en un hilo; 'list' muestra cómo terminó
+int battlefs_compact_async(BattleFS *fs) {
+    if (!fs) return -1;
+    if (atomic_load(&fs->image_size) == 0) {
+        fprintf(stderr, "Error: El sistema no se ha guardado\n");
+        return -1;
+    }
+
+    int idle = 0;
+    if (!atomic_compare_exchange_strong(&fs->compacting, &idle, 1)) {
+        fprintf(stderr, "Aviso: Ya hay una compactación en curso\n");
+        return -1;
+    }
+
+    pthread_mutex_lock(&fs->compact_lock);
+    if (fs->compactor_started) pthread_join(fs->compactor, NULL);
+    fs->compactor_started = pthread_create(&fs->compactor, NULL, compact_thread, fs) == 0;
+    int status = fs->compactor_started ? 0 : -1;
+    pthread_mutex_unlock(&fs->compact_lock);
+
+    if (status != 0) atomic_store(&fs->compacting, 0);
+    return status;
+}
+
+// Fuerza el fsync de los cambios que aún estén en el lote del diario
+int battlefs_sync(BattleFS *fs) {
+    if (!fs) return -1;
+    return journal_commit(fs->journal, 1);
+}
+
+// Estado al repetir el diario: los registros de datos quedan aparte hasta
+// que un enlace los usa, y siguen ahí por si otro los enlaza después de
+// borrarse todos los nombres del primero
+typedef struct {
+    BattleFS *fs;
+    HashIndex *pending;         // Clave de blob -> Blob con una referencia propia
+} Replay;
+
+static int replay_data(Replay *replay, FileEntry *entry) {
+    Blob *blob = new_blob(replay->fs, entry);
+    if (!blob) {
+        battlefs_entry_free(entry);
+        return -1;
+    }
+    free(entry);
+
+    // El mismo contenido escrito dos veces: basta el primero
+    char key[BLOB_KEY_SIZE];
+    blob_key(blob->hash, blob->codec, key);
+    if (hash_index_get(replay->pending, key) || hash_index_put(replay->pending, key, blob) != 0) {
+        blob_release(blob);
+    }
+    return 0;
+}
+
+// Blob de un enlace: el que está en el sistema o, si no, uno de un registro
+// de datos, que vuelve a publicarse
+static Blob* replay_blob(Replay *replay, const char *key) {
+    BattleFS *fs = replay->fs;
+    Blob *blob = fs->blobs ? hash_index_get(fs->blobs, key) : NULL;
+    if (blob) return blob;
+
+    blob = hash_index_get(replay->pending, key);
+    if (blob) publish_blob(fs, blob);
+    return blob;
+}
+
+static void release_pending(const char *key, void *value, void *ctx) {
+    (void)key;
+    (void)ctx;
+    blob_release(value);
+}
+
+// Un registro reemplaza lo que hubiera con ese nombre, así que repetirlo
+// no cambia el resultado
+static int replay_record(JournalOp op, const char *name, FileEntry *entry, void *ctx) {
+    Replay *replay = ctx;
+    BattleFS *fs = replay->fs;
+
+    if (op == JOURNAL_DATA) return replay_data(replay, entry);
+
+    // Un enlace toma los datos del blob que ya cargaron imagen o diario.
+    // Se resuelve antes de quitar el nombre: si este ya lo usaba, soltarlo
+    // podría sacar el blob de la tabla
+    if (op == JOURNAL_LINK) {
+        char key[BLOB_KEY_SIZE];
+        blob_key(entry->content_hash, entry->codec, key);
+        Blob *blob = replay_blob(replay, key);
+        if (!blob || blob->compressed_size != entry->compressed_size ||
+            blob->num_chunks != entry->num_chunks) {
+            fprintf(stderr, "Error: El diario enlaza un contenido que no existe\n");
+            battlefs_entry_free(entry);
+            return -1;
+        }
+        FileEntry *current = find_entry(fs, name);
+        if (current && current->blob == blob) {
+            battlefs_entry_free(entry);
+            return 0;
+        }
+        entry->compressed_data = blob->compressed_data;
+        entry->chunk_offsets = blob->chunk_offsets;
+        entry->mapped = 1;
+    }
+
+    if (find_entry(fs, name)) {
+        FileEntry *old = unlink_locked(fs, name);
+        if (!old) {
+            battlefs_entry_free(entry);
+            return -1;
+        }
+        battlefs_entry_release(old);
+    }
+
+    if (op != JOURNAL_DELETE && insert_locked(fs, name, entry, 1) != 0) {
+        battlefs_entry_free(entry);
+        return -1;
+    }
     return 0;
 }
 
 BattleFS* battlefs_load(const char *system_name) {
-    (void)system_name;
-    printf("Funcionalidad de carga no implementada aún\n");
-    return NULL;
+    if (!system_name) return NULL;
+
+    char *path = system_path(system_name, IMAGE_EXTENSION);
+    if (!path) return NULL;
+
+    BattleFS *fs = battlefs_init(system_name);
+    if (!fs) {
+        free(path);
+        return NULL;
+    }
+
+    // Imagen base y, encima, los cambios anotados desde que se guardó.
+    // Después el diario sigue tras el último registro válido
+    char *journal = system_path(system_name, JOURNAL_SUFFIX);
+    Replay replay = { fs, hash_index_init() };
+    uint64_t valid = 0;
+    int status = journal && replay.pending && image_map(fs, path) == 0 &&
+                 journal_replay(journal, replay_record, &replay, &valid) >= 0 ? 0 : -1;
+    // Los datos que nadie enlazó se liberan aquí; el resto sigue en sus entradas
+    hash_index_foreach(replay.pending, release_pending, NULL);
+    hash_index_free(replay.pending);
+
+    if (status != 0 || journal_attach(fs->journal, journal, valid) != 0 ||
+        remember_image(fs, system_name, path) != 0) {
+        battlefs_free(fs);
+        free(path);
+        free(journal);
+        return NULL;
+    }
+
+    free(path);
+    free(journal);
+    return fs;
 }
 
 void battlefs_free(BattleFS *fs) {
     if (!fs) return;
+
+    // Una compactación en curso usa las entradas y el diario
+    pthread_mutex_lock(&fs->compact_lock);
+    if (fs->compactor_started) pthread_join(fs->compactor, NULL);
+    fs->compactor_started = 0;
+    pthread_mutex_unlock(&fs->compact_lock);
     
     if (fs->index) {
         bplus_tree_list(fs->index, free_entry);
         bplus_tree_free(fs->index);
     }
+    hash_index_free(fs->lookup);
+    hash_index_free(fs->blobs);
+    journal_free(fs->journal);
+    pthread_rwlock_destroy(&fs->lock);
+    pthread_rwlock_destroy(&fs->staging_lock);
+    pthread_mutex_destroy(&fs->map_lock);
+    pthread_cond_destroy(&fs->map_idle);
+    pthread_mutex_destroy(&fs->persist_lock);
+    pthread_mutex_destroy(&fs->compact_lock);
+    free(fs->saved_name);
     
+    image_unmap(fs);
+    block_cache_free(fs->cache);
     free(fs->name);
     free(fs);
 }
\ No newline at end of file
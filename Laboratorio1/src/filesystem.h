@@ -4,30 +4,152 @@
 
 #include "tree.h"
 #include "compression.h"
+#include "codec.h"
+#include "cache.h"
+#include "hashindex.h"
 #include <stdint.h>
 #include <stddef.h>
+#include <stdatomic.h>
+#include <pthread.h>
 #include <sys/stat.h>
 
-typedef struct {
+// Tamaño original de cada bloque comprimido de forma independiente
+#define BATTLEFS_CHUNK_SIZE (256 * 1024)
+// Presupuesto de la caché de bloques descomprimidos
+#define BATTLEFS_CACHE_BUDGET (64 * 1024 * 1024)
+// Buffer alineado de extract: se vuelca con write() de este tamaño
+#define BATTLEFS_WRITE_BUFFER (1024 * 1024)
+#define BATTLEFS_WRITE_ALIGN 4096
+// Tabla hash junto al árbol para las búsquedas por nombre exacto
+#ifndef BATTLEFS_HASH_INDEX
+#define BATTLEFS_HASH_INDEX 1
+#endif
+// Compactación automática tras un borrado: al menos 16 MB recuperables que
+// además sean la mitad de lo que el sistema ocupa en disco
+#define BATTLEFS_COMPACT_MIN_BYTES (16 * 1024 * 1024)
+#define BATTLEFS_COMPACT_RATIO 0.5
+// Códec de los archivos nuevos mientras no se elija otro
+#ifndef BATTLEFS_CODEC
+#define BATTLEFS_CODEC CODEC_AUTO
+#endif
+// Archivos idénticos comparten los datos comprimidos
+#ifndef BATTLEFS_DEDUP
+#define BATTLEFS_DEDUP 1
+#endif
+
+// Datos comprimidos compartidos por todos los archivos de idéntico
+// contenido. Es dueño de datos y tabla de bloques (salvo si vienen del mapeo)
+typedef struct Blob {
+    uint64_t hash;              // XXH64 del contenido original
+    CodecId codec;
     uint8_t *compressed_data;
     size_t compressed_size;
     size_t original_size;
+    size_t chunk_size;
+    size_t num_chunks;
+    uint64_t *chunk_offsets;
+    int mapped;
+    uint64_t id;                // Clave en la caché, común a sus archivos
+    int links;                  // Nombres que lo usan (con el cerrojo del sistema)
+    atomic_int refs;            // Entradas vivas que lo usan
+    uint64_t image_offset;      // Dónde quedó en la imagen en curso (con persist_lock)
+    uint64_t image_table;       // Y su tabla de bloques, desde el inicio del archivo
+} Blob;
+
+typedef struct {
+    uint8_t *compressed_data;   // Bloques etiquetados con su códec, uno tras otro
+    size_t compressed_size;
+    size_t original_size;
+    size_t chunk_size;          // Bytes originales por bloque (el último puede ser menor)
+    size_t num_chunks;
+    uint64_t *chunk_offsets;    // num_chunks + 1 desplazamientos en compressed_data
+    int mapped;                 // Datos y tabla de bloques apuntan al mapeo de la imagen
+    CodecId codec;              // Con el que se comprimió (en modo automático, el de
+                                // más bloques reducidos); stored si ninguno redujo
+    CodecStats sampling;        // Decisiones del modo automático al comprimirla
+    uint64_t content_hash;      // XXH64 del contenido original
+    Blob *blob;                 // Dueño de datos y tabla una vez en el sistema
+    uint64_t id;                // Clave en la caché; la del blob
+    atomic_int refs;            // El sistema tiene una; cada lectura en curso, otra
 } FileEntry;
 
+struct Journal;
+
+typedef struct {
+    size_t files;
+    uint64_t bytes_before;      // Imagen y diario antes y después
+    uint64_t bytes_after;
+    double seconds;
+} CompactStats;
+
+// Seguro entre hilos: el cerrojo protege el índice y la tabla hash y solo se
+// toma para buscar o modificar nombres. Comprimir, descomprimir y escribir
+// los datos en el diario ocurre fuera de él, así que una lectura nunca
+// espera a la compresión ni al disco por otro archivo, y un borrado no
+// libera una entrada que alguien está leyendo. Con él solo se anotan
+// registros pequeños (nombres y borrados), en el mismo orden que el índice.
+// Crear, cargar y liberar el sistema no son concurrentes con nada más
 typedef struct {
-    BPlusTree *index;
+    BPlusTree *index;           // Orden: listados y prefijos
+    HashIndex *lookup;          // Nombre exacto; NULL si está desactivado
+    HashIndex *blobs;           // Hash de contenido (hex) -> Blob; NULL sin deduplicación
+    pthread_rwlock_t lock;
+    // Compartido mientras una inserción tiene datos en el diario aún sin
+    // nombre; save y compact lo toman en exclusiva para no cortar el diario
+    // entre los datos y su enlace. Se toma antes que lock
+    pthread_rwlock_t staging_lock;
+    uint64_t next_id;           // Con el cerrojo de escritura
     char *name;
-    size_t total_files;
-    size_t total_compressed_size;
-    size_t total_original_size;
+    atomic_size_t total_files;  // Se leen sin cerrojo para las estadísticas
+    atomic_size_t total_compressed_size;
+    atomic_size_t total_original_size;
+    atomic_size_t stored_compressed_size;   // Solo blobs distintos
+    int compress_threads;       // Hilos para comprimir los bloques de un archivo
+    CodecId codec;              // Para los archivos que se añadan
+    CodecStats sampling;        // Acumulado de las entradas nuevas, con el cerrojo
+    BlockCache *cache;
+    struct Journal *journal;    // Cambios desde el último save/load; inactivo hasta entonces
+    void *map_base;           // Imagen mapeada por battlefs_load
+    size_t map_size;
+    // Lecturas que usan los datos de sus entradas sin cerrojo. Para cambiar
+    // de mapeo la compactación marca remapping, que frena a las nuevas, y
+    // espera a que no quede ninguna. Se toma antes que staging_lock
+    pthread_mutex_t map_lock;
+    pthread_cond_t map_idle;
+    size_t map_readers;
+    int remapping;
+    pthread_mutex_t persist_lock;   // Un save o una compactación a la vez
+    char *saved_name;           // Sistema del último save/load (con persist_lock)
+    atomic_size_t image_size;   // Bytes de su imagen; 0 si no se ha guardado
+    pthread_mutex_t compact_lock;   // Protege compactor y compactor_started
+    pthread_t compactor;
+    int compactor_started;
+    atomic_int compacting;
+    CompactStats compaction;    // Última compactación en segundo plano (con el cerrojo)
+    int compacted;              // 1 si terminó bien, -1 si falló, 0 si no hubo
 } BattleFS;
 
 BattleFS* battlefs_init(const char *name);
 int battlefs_create(BattleFS *fs, const char *filename);
+FileEntry* battlefs_compress_fd(int fd, int num_threads, CodecId codec);
+FileEntry* battlefs_compress_file(const char *filename, int num_threads, CodecId codec);
+uint8_t* battlefs_decompress_chunk(const FileEntry *entry, size_t chunk, size_t *size);
+int battlefs_insert(BattleFS *fs, const char *filename, FileEntry *entry);
+int battlefs_insert_batch(BattleFS *fs, char **filenames, FileEntry **entries, size_t count);
+void battlefs_entry_free(FileEntry *entry);
+void battlefs_entry_release(FileEntry *entry);
+void battlefs_register(BattleFS *fs, const char *filename, FileEntry *entry);
 int battlefs_read(BattleFS *fs, const char *filename);
+int battlefs_read_range(BattleFS *fs, const char *filename, size_t offset, size_t length);
+int battlefs_stream(BattleFS *fs, const char *filename, LZWSink sink, void *ctx);
+int battlefs_extract(BattleFS *fs, const char *filename, const char *dest_path);
 int battlefs_delete(BattleFS *fs, const char *filename);
 void battlefs_list(BattleFS *fs);
+void battlefs_list_prefix(BattleFS *fs, const char *prefix);
 int battlefs_save(BattleFS *fs, const char *system_name);
+int battlefs_sync(BattleFS *fs);
+int battlefs_compact(BattleFS *fs, CompactStats *stats);
+int battlefs_compact_async(BattleFS *fs);
 BattleFS* battlefs_load(const char *system_name);
 void battlefs_free(BattleFS *fs);
 
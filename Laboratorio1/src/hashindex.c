@@ -0,0 +1,133 @@
+
+#define _POSIX_C_SOURCE 200809L
+#include "hashindex.h"
+#include <stdlib.h>
+#include <string.h>
+
+static uint64_t key_hash(const char *key) {
+    // FNV-1a, como la caché de bloques
+    uint64_t hash = 14695981039346656037ULL;
+    for (const unsigned char *p = (const unsigned char*)key; *p; p++) {
+        hash ^= *p;
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+HashIndex* hash_index_init(void) {
+    HashIndex *index = calloc(1, sizeof(HashIndex));
+    if (!index) return NULL;
+
+    index->slots = calloc(HASH_INDEX_INITIAL, sizeof(HashSlot));
+    if (!index->slots) {
+        free(index);
+        return NULL;
+    }
+
+    index->capacity = HASH_INDEX_INITIAL;
+    return index;
+}
+
+void hash_index_free(HashIndex *index) {
+    if (!index) return;
+
+    for (size_t i = 0; i < index->capacity; i++) {
+        free(index->slots[i].key);
+    }
+    free(index->slots);
+    free(index);
+}
+
+// Hueco de la clave, o el primero libre de su secuencia de sondeo
+static size_t find_slot(const HashIndex *index, const char *key, uint64_t hash) {
+    size_t mask = index->capacity - 1;
+    size_t i = hash & mask;
+    while (index->slots[i].key) {
+        if (index->slots[i].hash == hash && strcmp(index->slots[i].key, key) == 0) break;
+        i = (i + 1) & mask;
+    }
+    return i;
+}
+
+void* hash_index_get(const HashIndex *index, const char *key) {
+    if (!index || !key) return NULL;
+
+    size_t i = find_slot(index, key, key_hash(key));
+    return index->slots[i].key ? index->slots[i].value : NULL;
+}
+
+static int grow(HashIndex *index) {
+    size_t capacity = index->capacity * 2;
+    HashSlot *slots = calloc(capacity, sizeof(HashSlot));
+    if (!slots) return -1;
+
+    // Las claves ya son únicas: basta con el primer hueco libre
+    for (size_t i = 0; i < index->capacity; i++) {
+        HashSlot *slot = &index->slots[i];
+        if (!slot->key) continue;
+        size_t j = slot->hash & (capacity - 1);
+        while (slots[j].key) j = (j + 1) & (capacity - 1);
+        slots[j] = *slot;
+    }
+
+    free(index->slots);
+    index->slots = slots;
+    index->capacity = capacity;
+    return 0;
+}
+
+// Copia la clave; falla si ya existe o si no hay memoria
+int hash_index_put(HashIndex *index, const char *key, void *value) {
+    if (!index || !key) return -1;
+
+    // Ocupación máxima del 50% para que los sondeos sigan siendo cortos
+    if ((index->count + 1) * 2 > index->capacity && grow(index) != 0) return -1;
+
+    uint64_t hash = key_hash(key);
+    size_t i = find_slot(index, key, hash);
+    if (index->slots[i].key) return -1;
+
+    char *copy = strdup(key);
+    if (!copy) return -1;
+    index->slots[i].hash = hash;
+    index->slots[i].key = copy;
+    index->slots[i].value = value;
+    index->count++;
+    return 0;
+}
+
+int hash_index_remove(HashIndex *index, const char *key) {
+    if (!index || !key) return -1;
+
+    size_t mask = index->capacity - 1;
+    size_t i = find_slot(index, key, key_hash(key));
+    if (!index->slots[i].key) return -1;
+
+    free(index->slots[i].key);
+    index->slots[i].key = NULL;
+    index->count--;
+
+    // Sin lápidas: se adelantan las claves posteriores que ya no serían
+    // alcanzables desde su posición ideal
+    size_t j = i;
+    while (1) {
+        j = (j + 1) & mask;
+        if (!index->slots[j].key) break;
+        size_t ideal = index->slots[j].hash & mask;
+        int reachable = i <= j ? (ideal > i && ideal <= j) : (ideal > i || ideal <= j);
+        if (reachable) continue;
+        index->slots[i] = index->slots[j];
+        index->slots[j].key = NULL;
+        i = j;
+    }
+    return 0;
+}
+
+void hash_index_foreach(const HashIndex *index,
+                        void (*callback)(const char *key, void *value, void *ctx), void *ctx) {
+    if (!index || !callback) return;
+
+    for (size_t i = 0; i < index->capacity; i++) {
+        if (index->slots[i].key) callback(index->slots[i].key, index->slots[i].value, ctx);
+    }
+}
@@ -0,0 +1,32 @@
+
+#ifndef HASHINDEX_H
+#define HASHINDEX_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define HASH_INDEX_INITIAL 64   // Potencia de dos
+
+// Tabla de direccionamiento abierto (sondeo lineal) para búsquedas exactas
+typedef struct {
+    uint64_t hash;
+    char *key;      // NULL si el hueco está libre
+    void *value;
+} HashSlot;
+
+typedef struct {
+    HashSlot *slots;
+    size_t capacity;
+    size_t count;
+} HashIndex;
+
+HashIndex* hash_index_init(void);
+void hash_index_free(HashIndex *index);
+void* hash_index_get(const HashIndex *index, const char *key);
+int hash_index_put(HashIndex *index, const char *key, void *value);
+int hash_index_remove(HashIndex *index, const char *key);
+// Sin orden; el callback no debe modificar la tabla
+void hash_index_foreach(const HashIndex *index,
+                        void (*callback)(const char *key, void *value, void *ctx), void *ctx);
+
+#endif
@@ -0,0 +1,413 @@
+
+#define _POSIX_C_SOURCE 200809L
+#include "image.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define PAD8(n) (((n) + 7) & ~(size_t)7)
+
+static void collect_entry(const char *filename, void *value, void *ctx) {
+    EntryList *list = ctx;
+    if (list->count == list->capacity) {
+        size_t new_capacity = list->capacity ? list->capacity * 2 : 64;
+        char **names = realloc(list->names, new_capacity * sizeof(*names));
+        if (!names) return;
+        list->names = names;
+        FileEntry **entries = realloc(list->entries, new_capacity * sizeof(*entries));
+        if (!entries) return;
+        list->entries = entries;
+        list->capacity = new_capacity;
+    }
+    // El árbol reconstruye la clave en un búfer temporal: hay que copiarla
+    char *name = strdup(filename);
+    if (!name) return;
+    FileEntry *entry = value;
+    atomic_fetch_add_explicit(&entry->refs, 1, memory_order_relaxed);
+    list->names[list->count] = name;
+    list->entries[list->count] = entry;
+    list->count++;
+}
+
+void image_snapshot_free(EntryList *list) {
+    for (size_t i = 0; i < list->count; i++) {
+        free(list->names[i]);
+        battlefs_entry_release(list->entries[i]);
+    }
+    free(list->names);
+    free(list->entries);
+    memset(list, 0, sizeof(*list));
+}
+
+static int write_padding(FILE *file, size_t count) {
+    static const uint8_t zeros[IMAGE_ALIGN];
+    while (count > 0) {
+        size_t chunk = count < sizeof(zeros) ? count : sizeof(zeros);
+        if (fwrite(zeros, 1, chunk, file) != chunk) return -1;
+        count -= chunk;
+    }
+    return 0;
+}
+
+// Instantánea de las entradas en orden del árbol; requiere el cerrojo del
+// sistema solo mientras se toma
+int image_snapshot(BattleFS *fs, EntryList *list) {
+    if (!fs || !list) return -1;
+
+    memset(list, 0, sizeof(*list));
+    bplus_tree_foreach(fs->index, collect_entry, list);
+    if (list->count != atomic_load(&fs->total_files)) {
+        image_snapshot_free(list);
+        return -1;
+    }
+    return 0;
+}
+
+int image_write(BattleFS *fs, const char *path) {
+    if (!fs || !path) return -1;
+
+    EntryList list;
+    if (image_snapshot(fs, &list) != 0) return -1;
+    int status = image_write_entries(&list, path);
+    image_snapshot_free(&list);
+    return status;
+}
+
+// Escribe la imagen en un temporal y la renombra: quien la mapee ve la
+// anterior o la nueva completa. Los blobs quedan en el orden de la lista
+int image_write_entries(const EntryList *list, const char *path) {
+    if (!list || !path) return -1;
+
+    uint64_t *data_offsets = malloc((list->count ? list->count : 1) * sizeof(uint64_t));
+    if (!data_offsets) return -1;
+
+    // Cada blob se escribe una vez, con el primer archivo que lo usa: el
+    // blob anota su posición. Solo escribe una imagen a la vez (persist_lock)
+    for (size_t i = 0; i < list->count; i++) {
+        if (list->entries[i]->blob) list->entries[i]->blob->image_offset = IMAGE_UNWRITTEN;
+    }
+
+    // Calcular la distribución: índice justo tras la cabecera, datos alineados
+    size_t index_size = 0;
+    size_t data_size = 0;
+    int status = 0;
+    for (size_t i = 0; i < list->count; i++) {
+        FileEntry *entry = list->entries[i];
+        size_t record_size = sizeof(ImageIndexRecord) + PAD8(strlen(list->names[i]))
+                             + (entry->num_chunks + 1) * sizeof(uint64_t);
+        if (entry->blob && entry->blob->image_offset != IMAGE_UNWRITTEN) {
+            data_offsets[i] = entry->blob->image_offset;
+            index_size += record_size;
+            continue;
+        }
+        if (entry->blob) {
+            entry->blob->image_offset = data_size;
+            entry->blob->image_table = sizeof(ImageHeader) + index_size
+                                       + sizeof(ImageIndexRecord);
+        }
+        index_size += record_size;
+        data_offsets[i] = data_size;
+        data_size += entry->compressed_size;
+    }
+
+    ImageHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, IMAGE_MAGIC, sizeof(header.magic));
+    header.version = IMAGE_VERSION;
+    header.num_entries = list->count;
+    header.index_offset = sizeof(ImageHeader);
+    header.index_size = index_size;
+    header.data_offset = (header.index_offset + index_size + IMAGE_ALIGN - 1)
+                         & ~(uint64_t)(IMAGE_ALIGN - 1);
+    header.data_size = data_size;
+
+    // Escribir a un temporal y renombrar para no dejar imágenes a medias
+    size_t tmp_len = strlen(path) + 5;
+    char *tmp_path = malloc(tmp_len);
+    if (!tmp_path) {
+        free(data_offsets);
+        return -1;
+    }
+    snprintf(tmp_path, tmp_len, "%s.tmp", path);
+
+    FILE *file = fopen(tmp_path, "wb");
+    if (!file) {
+        perror("Error al crear imagen");
+        free(tmp_path);
+        free(data_offsets);
+        return -1;
+    }
+
+    if (fwrite(&header, sizeof(header), 1, file) != 1) status = -1;
+
+    for (size_t i = 0; i < list->count && status == 0; i++) {
+        size_t name_len = strlen(list->names[i]);
+        ImageIndexRecord record;
+        memset(&record, 0, sizeof(record));
+        record.data_offset = data_offsets[i];
+        record.compressed_size = list->entries[i]->compressed_size;
+        record.original_size = list->entries[i]->original_size;
+        record.chunk_size = list->entries[i]->chunk_size;
+        record.num_chunks = list->entries[i]->num_chunks;
+        record.content_hash = list->entries[i]->content_hash;
+        record.codec = list->entries[i]->codec;
+        record.name_len = (uint32_t)name_len;
+
+        size_t table_len = record.num_chunks + 1;
+        if (fwrite(&record, sizeof(record), 1, file) != 1 ||
+            fwrite(list->entries[i]->chunk_offsets, sizeof(uint64_t), table_len, file) != table_len ||
+            fwrite(list->names[i], 1, name_len, file) != name_len ||
+            write_padding(file, PAD8(name_len) - name_len) != 0) {
+            status = -1;
+        }
+    }
+
+    if (status == 0) {
+        status = write_padding(file, header.data_offset - header.index_offset - index_size);
+    }
+
+    // Los blobs salen en orden creciente de desplazamiento: un archivo que
+    // apunta por detrás de lo escrito comparte un blob ya volcado
+    uint64_t written_size = 0;
+    for (size_t i = 0; i < list->count && status == 0; i++) {
+        FileEntry *entry = list->entries[i];
+        if (data_offsets[i] != written_size) continue;
+        if (fwrite(entry->compressed_data, 1, entry->compressed_size, file)
+            != entry->compressed_size) {
+            status = -1;
+        }
+        written_size += entry->compressed_size;
+    }
+
+    if (fflush(file) != 0 || fsync(fileno(file)) != 0) status = -1;
+    if (fclose(file) != 0) status = -1;
+
+    if (status == 0 && rename(tmp_path, path) != 0) {
+        perror("Error al renombrar imagen");
+        status = -1;
+    }
+    if (status != 0) unlink(tmp_path);
+
+    free(tmp_path);
+    free(data_offsets);
+    return status;
+}
+
+// Mapea la imagen entera y comprueba la cabecera; no toca el sistema
+static uint8_t* map_file(const char *path, size_t *size) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        perror("Error al abrir imagen");
+        return NULL;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(ImageHeader)) {
+        fprintf(stderr, "Error: Imagen inválida\n");
+        close(fd);
+        return NULL;
+    }
+
+    size_t map_size = (size_t)st.st_size;
+    uint8_t *base = mmap(NULL, map_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) {
+        perror("Error al mapear imagen");
+        return NULL;
+    }
+
+    const ImageHeader *header = (const ImageHeader*)base;
+    if (memcmp(header->magic, IMAGE_MAGIC, sizeof(header->magic)) != 0 ||
+        header->version != IMAGE_VERSION ||
+        header->index_offset > map_size ||
+        header->index_size > map_size - header->index_offset ||
+        header->data_offset > map_size ||
+        header->data_size > map_size - header->data_offset) {
+        fprintf(stderr, "Error: Cabecera de imagen inválida\n");
+        munmap(base, map_size);
+        return NULL;
+    }
+    *size = map_size;
+    return base;
+}
+
+int image_map(BattleFS *fs, const char *path) {
+    if (!fs || !path) return -1;
+
+    size_t map_size;
+    uint8_t *base = map_file(path, &map_size);
+    if (!base) return -1;
+
+    const ImageHeader *header = (const ImageHeader*)base;
+    fs->map_base = base;
+    fs->map_size = map_size;
+
+    const uint8_t *cursor = base + header->index_offset;
+    const uint8_t *index_end = cursor + header->index_size;
+    const uint8_t *data = base + header->data_offset;
+
+    // El índice está en orden del árbol: se reconstruye de una pasada
+    uint64_t count = 0;
+    char **names = NULL;
+    FileEntry **entries = NULL;
+    if (header->num_entries > header->index_size / sizeof(ImageIndexRecord)) goto corrupt;
+    if (header->num_entries > 0) {
+        names = malloc(header->num_entries * sizeof(*names));
+        entries = malloc(header->num_entries * sizeof(*entries));
+        if (!names || !entries) goto corrupt;
+    }
+
+    for (uint64_t i = 0; i < header->num_entries; i++) {
+        ImageIndexRecord record;
+        if ((size_t)(index_end - cursor) < sizeof(record)) goto corrupt;
+        memcpy(&record, cursor, sizeof(record));
+        cursor += sizeof(record);
+
+        if (record.num_chunks == 0 || record.chunk_size == 0 || record.codec >= CODEC_COUNT ||
+            record.num_chunks != (record.original_size + record.chunk_size - 1) / record.chunk_size ||
+            record.num_chunks >= (size_t)(index_end - cursor) / sizeof(uint64_t) ||
+            record.data_offset > header->data_size ||
+            record.compressed_size > header->data_size - record.data_offset) {
+            goto corrupt;
+        }
+
+        // La tabla de bloques queda alineada a 8 dentro del mapeo
+        uint64_t *chunk_offsets = (uint64_t*)cursor;
+        cursor += (record.num_chunks + 1) * sizeof(uint64_t);
+        if ((size_t)(index_end - cursor) < PAD8(record.name_len) ||
+            chunk_offsets[record.num_chunks] != record.compressed_size) {
+            goto corrupt;
+        }
+
+        char *name = malloc(record.name_len + 1);
+        FileEntry *entry = calloc(1, sizeof(FileEntry));
+        if (!name || !entry) {
+            free(name);
+            free(entry);
+            goto corrupt;
+        }
+        memcpy(name, cursor, record.name_len);
+        name[record.name_len] = '\0';
+        cursor += PAD8(record.name_len);
+
+        // Los datos comprimidos apuntan directamente al mapeo
+        entry->compressed_data = (uint8_t*)(data + record.data_offset);
+        entry->compressed_size = record.compressed_size;
+        entry->original_size = record.original_size;
+        entry->chunk_size = record.chunk_size;
+        entry->num_chunks = record.num_chunks;
+        entry->chunk_offsets = chunk_offsets;
+        entry->mapped = 1;
+        entry->codec = (CodecId)record.codec;
+        entry->content_hash = record.content_hash;
+        entry->blob = NULL;
+        entry->id = 0;
+        atomic_init(&entry->refs, 1);
+
+        names[count] = name;
+        entries[count] = entry;
+        count++;
+    }
+
+    // Nombres desordenados o repetidos también son un índice corrupto
+    if (bplus_tree_bulk_load(fs->index, (const char *const *)names,
+                             (void *const *)entries, count) != 0) {
+        goto corrupt;
+    }
+
+    for (uint64_t i = 0; i < count; i++) {
+        battlefs_register(fs, names[i], entries[i]);
+        free(names[i]);
+    }
+    free(names);
+    free(entries);
+    return 0;
+
+corrupt:
+    fprintf(stderr, "Error: Índice de imagen corrupto\n");
+    for (uint64_t i = 0; i < count; i++) {
+        free(names[i]);
+        free(entries[i]);
+    }
+    free(names);
+    free(entries);
+    return -1;
+}
+
+typedef struct {
+    const uint8_t *base;
+    size_t size;
+    int apply;
+    int failed;
+} Rebase;
+
+// Lleva al mapeo nuevo los datos del blob de una entrada que apunta al
+// mapeo viejo, con la posición anotada al escribir la imagen. Sin aplicar
+// solo comprueba que todas tienen sitio
+static void rebase_entry(const char *filename, void *value, void *ctx) {
+    (void)filename;
+    FileEntry *entry = value;
+    Rebase *rebase = ctx;
+    Blob *blob = entry->blob;
+    if (blob ? !blob->mapped : !entry->mapped) return;
+
+    const ImageHeader *header = (const ImageHeader*)rebase->base;
+    size_t table_size = (blob ? blob->num_chunks + 1 : 0) * sizeof(uint64_t);
+    if (!blob || blob->image_offset == IMAGE_UNWRITTEN ||
+        blob->image_offset > header->data_size ||
+        blob->compressed_size > header->data_size - blob->image_offset ||
+        blob->image_table > header->index_offset + header->index_size ||
+        table_size > header->index_offset + header->index_size - blob->image_table) {
+        rebase->failed = 1;
+        return;
+    }
+    const uint64_t *table = (const uint64_t*)(rebase->base + blob->image_table);
+    if (table[blob->num_chunks] != blob->compressed_size) {
+        rebase->failed = 1;
+        return;
+    }
+    if (!rebase->apply) return;
+
+    blob->compressed_data = (uint8_t*)(rebase->base + header->data_offset + blob->image_offset);
+    blob->chunk_offsets = (uint64_t*)table;
+    entry->compressed_data = blob->compressed_data;
+    entry->chunk_offsets = blob->chunk_offsets;
+}
+
+// Tras escribir una imagen encima de la mapeada, pasa las entradas a la
+// nueva y suelta la vieja, que así deja de ocupar disco. Sin lecturas en
+// curso y con el cerrojo del sistema en exclusiva. Si alguna entrada no
+// está en la imagen nueva no cambia nada y se sigue con la vieja
+int image_remap(BattleFS *fs, const char *path) {
+    if (!fs || !path) return -1;
+    if (!fs->map_base) return 0;
+
+    size_t map_size;
+    uint8_t *base = map_file(path, &map_size);
+    if (!base) return -1;
+
+    Rebase rebase = { base, map_size, 0, 0 };
+    bplus_tree_foreach(fs->index, rebase_entry, &rebase);
+    if (rebase.failed) {
+        munmap(base, map_size);
+        return -1;
+    }
+    rebase.apply = 1;
+    bplus_tree_foreach(fs->index, rebase_entry, &rebase);
+
+    image_unmap(fs);
+    fs->map_base = base;
+    fs->map_size = map_size;
+    return 0;
+}
+
+void image_unmap(BattleFS *fs) {
+    if (!fs || !fs->map_base) return;
+    munmap(fs->map_base, fs->map_size);
+    fs->map_base = NULL;
+    fs->map_size = 0;
+}
@@ -0,0 +1,58 @@
+
+#ifndef IMAGE_H
+#define IMAGE_H
+
+#include "filesystem.h"
+#include <stdint.h>
+#include <stddef.h>
+
+// Contenedor en disco: cabecera | índice (en orden del árbol) | blobs
+#define IMAGE_MAGIC "BTFS"
+#define IMAGE_VERSION 1
+#define IMAGE_EXTENSION ".bfs"
+#define IMAGE_ALIGN 4096
+// Blob aún sin sitio en la imagen que se está escribiendo
+#define IMAGE_UNWRITTEN UINT64_MAX
+
+typedef struct {
+    char magic[4];
+    uint32_t version;
+    uint64_t num_entries;
+    uint64_t index_offset;
+    uint64_t index_size;
+    uint64_t data_offset;
+    uint64_t data_size;
+} ImageHeader;
+
+// Registro del índice, seguido de num_chunks + 1 desplazamientos de bloque
+// (uint64_t, relativos al blob) y de name_len bytes de nombre (relleno a 8).
+// Archivos de idéntico contenido apuntan al mismo blob
+typedef struct {
+    uint64_t data_offset;     // Relativo al inicio de la sección de datos
+    uint64_t compressed_size;
+    uint64_t original_size;
+    uint64_t chunk_size;
+    uint64_t num_chunks;
+    uint64_t content_hash;    // XXH64 del contenido original
+    uint32_t name_len;
+    uint32_t codec;
+} ImageIndexRecord;
+
+// Entradas en orden del árbol; cada una con una referencia propia, así que
+// sigue siendo válida aunque se borre del sistema mientras se escribe
+typedef struct {
+    char **names;
+    FileEntry **entries;
+    size_t count;
+    size_t capacity;
+} EntryList;
+
+int image_snapshot(BattleFS *fs, EntryList *list);
+void image_snapshot_free(EntryList *list);
+int image_write_entries(const EntryList *list, const char *path);
+int image_write(BattleFS *fs, const char *path);
+int image_map(BattleFS *fs, const char *path);
+int image_remap(BattleFS *fs, const char *path);
+void image_unmap(BattleFS *fs);
+
+#endif
@@ -0,0 +1,425 @@
+
+#define _POSIX_C_SOURCE 200809L
+#include "journal.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#define FNV_OFFSET 14695981039346656037ULL
+#define FNV_PRIME 1099511628211ULL
+
+static uint64_t fnv1a(uint64_t hash, const void *data, size_t size) {
+    const unsigned char *p = data;
+    for (size_t i = 0; i < size; i++) {
+        hash ^= p[i];
+        hash *= FNV_PRIME;
+    }
+    return hash;
+}
+
+static int pwrite_all(int fd, const void *data, size_t size, uint64_t offset) {
+    const uint8_t *p = data;
+    while (size > 0) {
+        ssize_t n = pwrite(fd, p, size, (off_t)offset);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        p += n;
+        size -= (size_t)n;
+        offset += (uint64_t)n;
+    }
+    return 0;
+}
+
+Journal* journal_init(void) {
+    Journal *journal = calloc(1, sizeof(Journal));
+    if (!journal) return NULL;
+
+    journal->fd = -1;
+    pthread_mutex_init(&journal->lock, NULL);
+    return journal;
+}
+
+static void journal_close(Journal *journal) {
+    if (journal->fd < 0) return;
+    if (journal->pending_records > 0) fdatasync(journal->fd);
+    close(journal->fd);
+    journal->fd = -1;
+    journal->size = 0;
+    journal->pending_records = 0;
+    journal->pending_bytes = 0;
+}
+
+void journal_free(Journal *journal) {
+    if (!journal) return;
+    journal_close(journal);
+    pthread_mutex_destroy(&journal->lock);
+    free(journal);
+}
+
+// Asocia el diario a path conservando sus primeros keep bytes (los registros
+// ya aplicados); con keep = 0 empieza vacío, como tras guardar la imagen
+int journal_attach(Journal *journal, const char *path, uint64_t keep) {
+    if (!journal || !path) return -1;
+
+    pthread_mutex_lock(&journal->lock);
+    journal_close(journal);
+
+    int fd = open(path, O_RDWR | O_CREAT, 0644);
+    if (fd < 0) {
+        perror("Error al abrir el diario");
+        pthread_mutex_unlock(&journal->lock);
+        return -1;
+    }
+
+    // La cabecera se reescribe también al conservar registros
+    JournalHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, JOURNAL_MAGIC, sizeof(header.magic));
+    header.version = JOURNAL_VERSION;
+    if (keep < sizeof(header)) keep = sizeof(header);
+
+    int status = 0;
+    if (ftruncate(fd, (off_t)keep) != 0 || pwrite_all(fd, &header, sizeof(header), 0) != 0 ||
+        fdatasync(fd) != 0) {
+        status = -1;
+    }
+
+    if (status != 0) {
+        perror("Error al preparar el diario");
+        close(fd);
+    } else {
+        journal->fd = fd;
+        journal->size = keep;
+    }
+    pthread_mutex_unlock(&journal->lock);
+    return status;
+}
+
+int journal_active(Journal *journal) {
+    if (!journal) return 0;
+    pthread_mutex_lock(&journal->lock);
+    int active = journal->fd >= 0;
+    pthread_mutex_unlock(&journal->lock);
+    return active;
+}
+
+uint64_t journal_size(Journal *journal) {
+    if (!journal) return 0;
+    pthread_mutex_lock(&journal->lock);
+    uint64_t size = journal->fd >= 0 ? journal->size : 0;
+    pthread_mutex_unlock(&journal->lock);
+    return size;
+}
+
+// Sustituye el diario por uno nuevo en path con solo los registros desde el
+// byte from (los posteriores a una imagen recién escrita). El nuevo se
+// sincroniza antes de renombrarlo, así que una caída deja uno u otro entero
+int journal_rebase(Journal *journal, const char *path, uint64_t from) {
+    if (!journal || !path) return -1;
+
+    size_t tmp_len = strlen(path) + 5;
+    char *tmp_path = malloc(tmp_len);
+    uint8_t *buffer = malloc(JOURNAL_COPY_BUFFER);
+    if (!tmp_path || !buffer) {
+        free(tmp_path);
+        free(buffer);
+        return -1;
+    }
+    snprintf(tmp_path, tmp_len, "%s.tmp", path);
+
+    pthread_mutex_lock(&journal->lock);
+    if (from < sizeof(JournalHeader)) from = sizeof(JournalHeader);
+    if (from > journal->size) from = journal->size;
+
+    int fd = journal->fd >= 0 ? open(tmp_path, O_RDWR | O_CREAT | O_TRUNC, 0644) : -1;
+    int status = fd < 0 ? -1 : 0;
+
+    JournalHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, JOURNAL_MAGIC, sizeof(header.magic));
+    header.version = JOURNAL_VERSION;
+    if (status == 0) status = pwrite_all(fd, &header, sizeof(header), 0);
+
+    uint64_t size = sizeof(header);
+    for (uint64_t offset = from; status == 0 && offset < journal->size; ) {
+        size_t take = journal->size - offset < JOURNAL_COPY_BUFFER
+                      ? (size_t)(journal->size - offset) : JOURNAL_COPY_BUFFER;
+        ssize_t n = pread(journal->fd, buffer, take, (off_t)offset);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0 || pwrite_all(fd, buffer, (size_t)n, size) != 0) {
+            status = -1;
+            break;
+        }
+        offset += (uint64_t)n;
+        size += (uint64_t)n;
+    }
+
+    if (status == 0 && (fdatasync(fd) != 0 || rename(tmp_path, path) != 0)) status = -1;
+    if (status == 0) {
+        close(journal->fd);
+        journal->fd = fd;
+        journal->size = size;
+        journal->pending_records = 0;
+        journal->pending_bytes = 0;
+    } else {
+        perror("Error al reescribir el diario");
+        if (fd >= 0) close(fd);
+        unlink(tmp_path);
+    }
+    pthread_mutex_unlock(&journal->lock);
+
+    free(tmp_path);
+    free(buffer);
+    return status;
+}
+
+// Añade el registro sin sincronizar; si falla a medias se recorta el
+// archivo para que el siguiente registro no quede tras basura. Los de datos
+// no llevan nombre (name NULL)
+int journal_append(Journal *journal, JournalOp op, const char *name, const FileEntry *entry) {
+    if (!journal || (op != JOURNAL_DATA && !name) || (op != JOURNAL_DELETE && !entry)) return -1;
+
+    size_t name_len = name ? strlen(name) : 0;
+    if ((op != JOURNAL_DATA && name_len == 0) || name_len > JOURNAL_MAX_NAME) return -1;
+    int payload = op == JOURNAL_DATA;
+    // Sin archivo no hace falta ni el checksum de los datos
+    if (!journal_active(journal)) return 0;
+
+    JournalRecord record;
+    memset(&record, 0, sizeof(record));
+    record.op = op;
+    record.name_len = (uint32_t)name_len;
+
+    size_t table_len = 0;
+    if (op != JOURNAL_DELETE) {
+        record.original_size = entry->original_size;
+        record.chunk_size = entry->chunk_size;
+        record.num_chunks = entry->num_chunks;
+        record.compressed_size = entry->compressed_size;
+        record.content_hash = entry->content_hash;
+        record.codec = entry->codec;
+        table_len = (entry->num_chunks + 1) * sizeof(uint64_t);
+    }
+
+    uint64_t checksum = fnv1a(FNV_OFFSET, &record, sizeof(record));
+    checksum = fnv1a(checksum, name, name_len);
+    if (payload) {
+        checksum = fnv1a(checksum, entry->chunk_offsets, table_len);
+        checksum = fnv1a(checksum, entry->compressed_data, entry->compressed_size);
+    }
+    record.checksum = checksum;
+
+    pthread_mutex_lock(&journal->lock);
+    if (journal->fd < 0) {
+        pthread_mutex_unlock(&journal->lock);
+        return 0;
+    }
+
+    uint64_t offset = journal->size;
+    int status = pwrite_all(journal->fd, &record, sizeof(record), offset);
+    offset += sizeof(record);
+    if (status == 0 && name_len > 0) status = pwrite_all(journal->fd, name, name_len, offset);
+    offset += name_len;
+    if (status == 0 && payload) {
+        status = pwrite_all(journal->fd, entry->chunk_offsets, table_len, offset);
+        offset += table_len;
+        if (status == 0) {
+            status = pwrite_all(journal->fd, entry->compressed_data, entry->compressed_size, offset);
+        }
+        offset += entry->compressed_size;
+    }
+
+    if (status == 0) {
+        journal->pending_records++;
+        journal->pending_bytes += offset - journal->size;
+        journal->size = offset;
+    } else {
+        perror("Error al escribir el diario");
+        if (ftruncate(journal->fd, (off_t)journal->size) != 0) {
+            perror("Error al recortar el diario");
+        }
+    }
+    pthread_mutex_unlock(&journal->lock);
+    return status;
+}
+
+// Sincroniza si hay bastante pendiente (o siempre, con force). Quien llega
+// con el lote lleno paga el fsync de todos los registros anteriores
+int journal_commit(Journal *journal, int force) {
+    if (!journal) return -1;
+
+    int status = 0;
+    pthread_mutex_lock(&journal->lock);
+    if (journal->fd >= 0 && journal->pending_records > 0 &&
+        (force || journal->pending_records >= JOURNAL_SYNC_RECORDS ||
+         journal->pending_bytes >= JOURNAL_SYNC_BYTES)) {
+        if (fdatasync(journal->fd) == 0) {
+            journal->pending_records = 0;
+            journal->pending_bytes = 0;
+        } else {
+            perror("Error al sincronizar el diario");
+            status = -1;
+        }
+    }
+    pthread_mutex_unlock(&journal->lock);
+    return status;
+}
+
+static int valid_layout(const JournalRecord *record) {
+    return record->chunk_size > 0 && record->num_chunks > 0 && record->codec < CODEC_COUNT &&
+           record->num_chunks == (record->original_size + record->chunk_size - 1) / record->chunk_size;
+}
+
+// Enlace: solo metadatos, los datos los pone quien aplica el registro
+static FileEntry* link_entry(const JournalRecord *record) {
+    if (!valid_layout(record)) return NULL;
+
+    FileEntry *entry = calloc(1, sizeof(FileEntry));
+    if (!entry) return NULL;
+    entry->compressed_size = record->compressed_size;
+    entry->original_size = record->original_size;
+    entry->chunk_size = record->chunk_size;
+    entry->num_chunks = record->num_chunks;
+    entry->codec = (CodecId)record->codec;
+    entry->content_hash = record->content_hash;
+    atomic_init(&entry->refs, 1);
+    return entry;
+}
+
+static FileEntry* read_entry(FILE *file, const JournalRecord *record, uint64_t remaining,
+                             uint64_t *checksum) {
+    if (!valid_layout(record) ||
+        record->num_chunks >= remaining / sizeof(uint64_t) ||
+        record->compressed_size > remaining - (record->num_chunks + 1) * sizeof(uint64_t)) {
+        return NULL;
+    }
+
+    FileEntry *entry = calloc(1, sizeof(FileEntry));
+    if (!entry) return NULL;
+    size_t table_len = (record->num_chunks + 1) * sizeof(uint64_t);
+    entry->chunk_offsets = malloc(table_len);
+    entry->compressed_data = malloc(record->compressed_size ? record->compressed_size : 1);
+    entry->compressed_size = record->compressed_size;
+    entry->original_size = record->original_size;
+    entry->chunk_size = record->chunk_size;
+    entry->num_chunks = record->num_chunks;
+    entry->codec = (CodecId)record->codec;
+    entry->content_hash = record->content_hash;
+    atomic_init(&entry->refs, 1);
+
+    if (!entry->chunk_offsets || !entry->compressed_data ||
+        fread(entry->chunk_offsets, 1, table_len, file) != table_len ||
+        fread(entry->compressed_data, 1, entry->compressed_size, file) != entry->compressed_size ||
+        entry->chunk_offsets[entry->num_chunks] != entry->compressed_size) {
+        battlefs_entry_free(entry);
+        return NULL;
+    }
+    for (size_t i = 0; i < entry->num_chunks; i++) {
+        if (entry->chunk_offsets[i] > entry->chunk_offsets[i + 1]) {
+            battlefs_entry_free(entry);
+            return NULL;
+        }
+    }
+
+    *checksum = fnv1a(*checksum, entry->chunk_offsets, table_len);
+    *checksum = fnv1a(*checksum, entry->compressed_data, entry->compressed_size);
+    return entry;
+}
+
+// Aplica los registros en orden y para en el primero incompleto o dañado
+// (una escritura cortada por una caída). valid recibe el final del último
+// registro bueno, o 0 si no hay diario (o se cortó al crearlo). Una cabecera
+// de otro formato o versión es un error: el diario no se recorta ni se pierde
+int journal_replay(const char *path, JournalApply apply, void *ctx, uint64_t *valid) {
+    *valid = 0;
+
+    FILE *file = fopen(path, "rb");
+    if (!file) {
+        if (errno == ENOENT) return 0;
+        perror("Error al abrir el diario");
+        return -1;
+    }
+
+    struct stat st;
+    if (fstat(fileno(file), &st) != 0) {
+        perror("Error al abrir el diario");
+        fclose(file);
+        return -1;
+    }
+
+    // Sin cabecera completa no puede haber registros
+    JournalHeader header;
+    if ((uint64_t)st.st_size < sizeof(header)) {
+        fclose(file);
+        return 0;
+    }
+    if (fread(&header, sizeof(header), 1, file) != 1 ||
+        memcmp(header.magic, JOURNAL_MAGIC, sizeof(header.magic)) != 0 ||
+        header.version != JOURNAL_VERSION) {
+        fprintf(stderr, "Error: Cabecera de diario inválida o de otra versión en '%s'\n", path);
+        fclose(file);
+        return -1;
+    }
+
+    uint64_t file_size = (uint64_t)st.st_size;
+    uint64_t offset = sizeof(header);
+    char name[JOURNAL_MAX_NAME + 1];
+    int applied = 0;
+
+    for (;;) {
+        JournalRecord record;
+        if (fread(&record, sizeof(record), 1, file) != 1) break;
+
+        uint64_t remaining = file_size - offset - sizeof(record);
+        if (record.op < JOURNAL_DATA || record.op > JOURNAL_DELETE ||
+            (record.op == JOURNAL_DATA) != (record.name_len == 0) ||
+            record.name_len > JOURNAL_MAX_NAME || record.name_len > remaining ||
+            fread(name, 1, record.name_len, file) != record.name_len) {
+            break;
+        }
+        name[record.name_len] = '\0';
+
+        uint64_t expected = record.checksum;
+        record.checksum = 0;
+        uint64_t checksum = fnv1a(FNV_OFFSET, &record, sizeof(record));
+        checksum = fnv1a(checksum, name, record.name_len);
+
+        FileEntry *entry = NULL;
+        uint64_t size = sizeof(record) + record.name_len;
+        if (record.op == JOURNAL_DATA) {
+            entry = read_entry(file, &record, remaining - record.name_len, &checksum);
+            if (!entry) break;
+            size += (record.num_chunks + 1) * sizeof(uint64_t) + record.compressed_size;
+        } else if (record.op == JOURNAL_LINK) {
+            entry = link_entry(&record);
+            if (!entry) break;
+        } else if (record.original_size || record.num_chunks || record.compressed_size) {
+            break;
+        }
+
+        if (checksum != expected) {
+            battlefs_entry_free(entry);
+            break;
+        }
+        if (apply(record.op, name, entry, ctx) != 0) {
+            fclose(file);
+            return -1;
+        }
+        applied++;
+        offset += size;
+    }
+
+    if (offset < file_size) {
+        fprintf(stderr, "Aviso: Se descartan %llu bytes incompletos al final del diario\n",
+                (unsigned long long)(file_size - offset));
+    }
+    fclose(file);
+    *valid = offset;
+    return applied;
+}
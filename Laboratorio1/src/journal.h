@@ -0,0 +1,73 @@
+
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include "filesystem.h"
+#include <stdint.h>
+#include <stddef.h>
+#include <pthread.h>
+
+// Diario junto a la imagen guardada (<nombre>.bfs.journal): cabecera y
+// registros que solo se añaden al final. Cada registro lleva su cabecera,
+// el nombre y, si es de datos, la tabla de bloques y los datos
+#define JOURNAL_MAGIC "BTFJ"
+#define JOURNAL_VERSION 1
+#define JOURNAL_EXTENSION ".journal"
+#define JOURNAL_MAX_NAME 4096
+
+// fsync agrupado: se sincroniza al acumular cualquiera de los dos umbrales
+#define JOURNAL_SYNC_RECORDS 64
+#define JOURNAL_SYNC_BYTES (8 * 1024 * 1024)
+// Búfer para copiar la cola del diario al compactar
+#define JOURNAL_COPY_BUFFER (1024 * 1024)
+
+typedef enum {
+    JOURNAL_DATA = 1,       // Contenido sin nombre; no cambia nada hasta que lo enlacen
+    JOURNAL_LINK = 2,       // Nombre nuevo para un contenido ya guardado
+    JOURNAL_DELETE = 3
+} JournalOp;
+
+typedef struct {
+    char magic[4];
+    uint32_t version;
+} JournalHeader;
+
+typedef struct {
+    uint32_t op;
+    uint32_t name_len;
+    uint64_t original_size;
+    uint64_t chunk_size;
+    uint64_t num_chunks;
+    uint64_t compressed_size;
+    uint64_t content_hash;
+    uint32_t codec;
+    uint32_t reserved;
+    uint64_t checksum;      // FNV-1a de la cabecera (con este campo a 0) y la carga
+} JournalRecord;
+
+// Sin archivo asociado (fd < 0) las escrituras no hacen nada: el sistema
+// aún no se ha guardado
+typedef struct Journal {
+    int fd;
+    uint64_t size;              // Bytes válidos; un fallo recorta hasta aquí
+    size_t pending_records;     // Escritos desde el último fsync
+    size_t pending_bytes;
+    pthread_mutex_t lock;
+} Journal;
+
+// Recibe cada registro válido y pasa a ser dueño de entry (NULL en los
+// borrados; sin datos, solo tamaños y hash, en los enlaces). Los registros
+// de datos llegan con el nombre vacío
+typedef int (*JournalApply)(JournalOp op, const char *name, FileEntry *entry, void *ctx);
+
+Journal* journal_init(void);
+void journal_free(Journal *journal);
+int journal_attach(Journal *journal, const char *path, uint64_t keep);
+int journal_active(Journal *journal);
+uint64_t journal_size(Journal *journal);
+int journal_rebase(Journal *journal, const char *path, uint64_t from);
+int journal_append(Journal *journal, JournalOp op, const char *name, const FileEntry *entry);
+int journal_commit(Journal *journal, int force);
+int journal_replay(const char *path, JournalApply apply, void *ctx, uint64_t *valid);
+
+#endif
@@ -1,42 +1,76 @@
 
 #include "filesystem.h"
+#include "bench.h"
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
+#include <stdint.h>
+#include <ctype.h>
+#include <errno.h>
+#include <unistd.h>
 
 // Declaración de la función de carga
-int load_files_into_system(BattleFS *fs, const char *dir_path);
+int load_files_into_system(BattleFS *fs, const char *dir_path, int num_threads);
+
+static int default_threads(void) {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    return cpus > 0 ? (int)cpus : 1;
+}
+
+// Número decimal sin signo y sin nada detrás; -1 si no lo es
+static int parse_size(const char *text, size_t *value) {
+    // strtoull acepta espacios y signo delante, y "-1" daría un valor enorme
+    if (!isdigit((unsigned char)text[0])) return -1;
+
+    char *end;
+    errno = 0;
+    unsigned long long parsed = strtoull(text, &end, 10);
+    if (errno != 0 || *end != '\0' || parsed > SIZE_MAX) return -1;
+    *value = (size_t)parsed;
+    return 0;
+}
 
 void print_help() {
     printf("\n=== BattleFS - Sistema de archivos comprimidos ===\n");
     printf("Comandos disponibles:\n");
     printf("  init                     - Inicializa un sistema nuevo\n");
-    printf("  load_dir <directorio>    - Carga todos los archivos de un directorio\n");
+    printf("  load_dir <dir> [hilos]   - Carga todos los archivos de un directorio\n");
     printf("  create <archivo>         - Añade un archivo al sistema\n");
     printf("  read <archivo>           - Muestra contenido de un archivo\n");
+    printf("  read <arch> <desp> [n]   - Muestra n bytes (o hasta el final) desde el desplazamiento\n");
+    printf("  extract <arch> <destino> - Extrae un archivo a disco\n");
     printf("  delete <archivo>         - Elimina un archivo\n");
-    printf("  list                     - Lista todos los archivos\n");
+    printf("  list [prefijo]           - Lista los archivos (o los que empiezan por prefijo)\n");
     printf("  save <nombre>            - Guarda el sistema\n");
     printf("  load <nombre>            - Carga un sistema\n");
+    printf("  sync                     - Fuerza a disco los cambios del diario\n");
+    printf("  compact                  - Reescribe la imagen sin los datos borrados (ver 'list')\n");
+    printf("  codec [nombre]           - Códec de los archivos nuevos (auto, stored, rle, lz77, lzw)\n");
+    printf("  bench_tree [claves]      - Mide la búsqueda en el índice\n");
+    printf("  bench_concurrent [hilos] [claves] - Mide búsquedas en paralelo\n");
+    printf("  bench_codecs <archivo>   - Compara los códecs sobre un archivo\n");
     printf("  exit                     - Salir\n");
     printf("  help                     - Muestra esta ayuda\n");
 }
 
 int main() {
     BattleFS *fs = NULL;
+    char line[256];
     char command[256];
     char arg1[256];
     char arg2[256];
+    char arg3[256];
     
     printf("=== BattleFS - Sistema de archivos comprimidos ===\n");
     printf("Escribe 'help' para ver los comandos disponibles\n");
     
     while (1) {
         printf("\nBattleFS> ");
-        if (!fgets(command, sizeof(command), stdin)) break;
+        if (!fgets(line, sizeof(line), stdin)) break;
         
-        int args = sscanf(command, "%s %s %s", command, arg1, arg2);
-
+        int args = sscanf(line, "%s %s %s %s", command, arg1, arg2, arg3);
+        // Línea en blanco: command conserva el comando anterior
+        if (args < 1) continue;
         
         if (strcmp(command, "init") == 0) {
             if (fs) battlefs_free(fs);
@@ -47,7 +81,8 @@ int main() {
             if (!fs) {
                 printf("Error: Primero inicializa el sistema con 'init'\n");
             } else {
-                int loaded = load_files_into_system(fs, arg1);
+                int threads = args >= 3 ? atoi(arg2) : default_threads();
+                int loaded = load_files_into_system(fs, arg1, threads);
                 if (loaded >= 0) {
                     printf("Se cargaron %d archivos desde '%s'\n", loaded, arg1);
                     printf("El valor de arg1 es:%c\n",arg1);
@@ -68,6 +103,18 @@ int main() {
                 printf("Error al crear el archivo '%s'.\n", arg1);
             }
         }
+        else if (strcmp(command, "read") == 0 && args >= 3) {
+            size_t offset;
+            size_t length = SIZE_MAX; // Sin longitud: hasta el final
+            if (!fs) {
+                printf("Error: Sistema no inicializado. Use 'init' primero.\n");
+            } else if (parse_size(arg2, &offset) != 0 ||
+                       (args >= 4 && parse_size(arg3, &length) != 0)) {
+                printf("Error: El desplazamiento y la longitud deben ser números.\n");
+            } else if (battlefs_read_range(fs, arg1, offset, length) != 0) {
+                printf("Error al leer el archivo '%s'.\n", arg1);
+            }
+        }
         else if (strcmp(command, "read") == 0 && args >= 2) {
             if (!fs) {
                 printf("Error: Sistema no inicializado. Use 'init' primero.\n");
@@ -75,6 +122,15 @@ int main() {
                 printf("Error al leer el archivo '%s'.\n", arg1);
             }
         }
+        else if (strcmp(command, "extract") == 0 && args >= 3) {
+            if (!fs) {
+                printf("Error: Sistema no inicializado. Use 'init' primero.\n");
+            } else if (battlefs_extract(fs, arg1, arg2) == 0) {
+                printf("Archivo '%s' extraído en '%s'.\n", arg1, arg2);
+            } else {
+                printf("Error al extraer el archivo '%s'.\n", arg1);
+            }
+        }
         else if (strcmp(command, "delete") == 0 && args >= 2) {
             if (!fs) {
                 printf("Error: Sistema no inicializado. Use 'init' primero.\n");
@@ -87,6 +143,8 @@ int main() {
         else if (strcmp(command, "list") == 0) {
             if (!fs) {
                 printf("Error: Sistema no inicializado. Use 'init' primero.\n");
+            } else if (args >= 2) {
+                battlefs_list_prefix(fs, arg1);
             } else {
                 battlefs_list(fs);
             }
@@ -109,6 +167,46 @@ int main() {
                 printf("Error al cargar el sistema '%s'.\n", arg1);
             }
         }
+        else if (strcmp(command, "sync") == 0) {
+            if (!fs) {
+                printf("Error: Sistema no inicializado. Use 'init' primero.\n");
+            } else if (battlefs_sync(fs) == 0) {
+                printf("Diario sincronizado.\n");
+            } else {
+                printf("Error al sincronizar el diario.\n");
+            }
+        }
+        else if (strcmp(command, "compact") == 0) {
+            if (!fs) {
+                printf("Error: Sistema no inicializado. Use 'init' primero.\n");
+            } else if (battlefs_compact_async(fs) == 0) {
+                printf("Compactación en segundo plano iniciada.\n");
+            } else {
+                printf("Error al iniciar la compactación.\n");
+            }
+        }
+        else if (strcmp(command, "codec") == 0) {
+            if (!fs) {
+                printf("Error: Sistema no inicializado. Use 'init' primero.\n");
+            } else if (args < 2) {
+                printf("Códec actual: %s\n", codec_name(fs->codec));
+            } else if (codec_from_name(arg1) < 0) {
+                printf("Error: Códec desconocido '%s'.\n", arg1);
+            } else {
+                fs->codec = (CodecId)codec_from_name(arg1);
+                printf("Los archivos nuevos usarán '%s'.\n", codec_name(fs->codec));
+            }
+        }
+        else if (strcmp(command, "bench_tree") == 0) {
+            bench_tree_search(args >= 2 ? atoi(arg1) : 10000);
+        }
+        else if (strcmp(command, "bench_concurrent") == 0) {
+            bench_tree_concurrent(args >= 2 ? atoi(arg1) : default_threads(),
+                                  args >= 3 ? atoi(arg2) : 100000);
+        }
+        else if (strcmp(command, "bench_codecs") == 0 && args >= 2) {
+            bench_codecs(arg1);
+        }
         else if (strcmp(command, "exit") == 0) {
             if (fs) battlefs_free(fs);
             break;
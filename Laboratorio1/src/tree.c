@@ -5,72 +5,576 @@
 #include <stdlib.h>
 #include <string.h>
 
-static void free_node_recursive(BPlusNode *node) {
-    if (!node) return;
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+static BPlusSearchMode search_mode = BPLUS_SEARCH_DEFAULT;
+
+BPlusTree* bplus_tree_init() {
+    BPlusTree *tree = calloc(1, sizeof(BPlusTree));
+    if (!tree) return NULL;
     
-    if (!node->is_leaf) {
-        for (int i = 0; i <= node->num_keys; i++) {
-            free_node_recursive(node->pointers[i]);
+    pthread_rwlock_init(&tree->latch, NULL);
+    pthread_mutex_init(&tree->alloc_lock, NULL);
+    return tree;
+}
+
+void bplus_tree_set_concurrent(BPlusTree *tree, int enabled) {
+    if (tree) tree->concurrent = enabled;
+}
+
+// Los cerrojos solo actúan en modo concurrente
+static void tree_lock_shared(BPlusTree *tree) {
+    if (tree->concurrent) pthread_rwlock_rdlock(&tree->latch);
+}
+
+static void tree_lock_exclusive(BPlusTree *tree) {
+    if (tree->concurrent) pthread_rwlock_wrlock(&tree->latch);
+}
+
+static void tree_unlock(BPlusTree *tree) {
+    if (tree->concurrent) pthread_rwlock_unlock(&tree->latch);
+}
+
+static void leaf_lock_shared(BPlusTree *tree, BPlusNode *leaf) {
+    if (tree->concurrent) pthread_rwlock_rdlock(&leaf->latch);
+}
+
+static void leaf_lock_exclusive(BPlusTree *tree, BPlusNode *leaf) {
+    if (tree->concurrent) pthread_rwlock_wrlock(&leaf->latch);
+}
+
+static void leaf_unlock(BPlusTree *tree, BPlusNode *leaf) {
+    if (tree->concurrent) pthread_rwlock_unlock(&leaf->latch);
+}
+
+// Reparte size bytes del slab en curso; las piezas mayores que un slab
+// reciben uno propio que no sustituye al que se está llenando
+static void* slab_alloc(BPlusSlab **slabs, size_t size, size_t slab_size) {
+    size = (size + 7) & ~(size_t)7;
+    BPlusSlab *slab = *slabs;
+    
+    if (!slab || slab->size - slab->used < size) {
+        size_t capacity = size > slab_size ? size : slab_size;
+        BPlusSlab *fresh = malloc(sizeof(BPlusSlab) + capacity);
+        if (!fresh) return NULL;
+        fresh->size = capacity;
+        fresh->used = 0;
+        
+        if (slab && size > slab_size) {
+            fresh->next = slab->next;
+            slab->next = fresh;
+        } else {
+            fresh->next = slab;
+            *slabs = fresh;
         }
+        slab = fresh;
     }
     
-    for (int i = 0; i < node->num_keys; i++) {
-        free(node->keys[i]);
+    void *ptr = slab->data + slab->used;
+    slab->used += size;
+    return ptr;
+}
+
+static void free_slabs(BPlusSlab *slab) {
+    while (slab) {
+        BPlusSlab *next = slab->next;
+        free(slab);
+        slab = next;
+    }
+}
+
+static int size_class(size_t needed) {
+    int cls = 0;
+    size_t size = BPLUS_KEY_BUFFER;
+    while (size < needed) {
+        size *= 2;
+        cls++;
     }
+    return cls;
+}
+
+// Búfer de claves de la clase que cubre needed; los liberados se reutilizan
+// Puede llamarse con el latch compartido (varias hojas a la vez): las
+// listas libres y el slab en curso van bajo alloc_lock
+static char* alloc_bytes(BPlusTree *tree, size_t needed, uint32_t *capacity) {
+    int cls = size_class(needed);
+    if (cls >= BPLUS_KEY_CLASSES) return NULL;
+    
+    size_t size = (size_t)BPLUS_KEY_BUFFER << cls;
+    if (tree->concurrent) pthread_mutex_lock(&tree->alloc_lock);
+    char *buf = tree->free_bytes[cls];
+    if (buf) {
+        tree->free_bytes[cls] = *(char**)buf;
+    } else {
+        buf = slab_alloc(&tree->byte_slabs, size, BPLUS_BYTE_SLAB);
+    }
+    if (tree->concurrent) pthread_mutex_unlock(&tree->alloc_lock);
     
-    free(node);
+    if (buf) *capacity = size;
+    return buf;
 }
 
-BPlusTree* bplus_tree_init() {
-    BPlusTree *tree = calloc(1, sizeof(BPlusTree));
-    if (!tree) return NULL;
-    return tree;
+static void release_bytes(BPlusTree *tree, char *buf, size_t capacity) {
+    if (!buf) return;
+    int cls = size_class(capacity);
+    if (tree->concurrent) pthread_mutex_lock(&tree->alloc_lock);
+    *(char**)buf = tree->free_bytes[cls];
+    tree->free_bytes[cls] = buf;
+    if (tree->concurrent) pthread_mutex_unlock(&tree->alloc_lock);
 }
 
-static BPlusNode* create_node(int is_leaf) {
-    BPlusNode *node = calloc(1, sizeof(BPlusNode));
-    if (!node) return NULL;
+static BPlusNode* create_node(BPlusTree *tree, int is_leaf) {
+    BPlusNode *node = tree->free_nodes;
+    if (node) {
+        tree->free_nodes = node->next;
+    } else {
+        node = slab_alloc(&tree->node_slabs, sizeof(BPlusNode),
+                          BPLUS_SLAB_NODES * sizeof(BPlusNode));
+        if (!node) return NULL;
+    }
     
+    memset(node, 0, sizeof(BPlusNode));
     node->is_leaf = is_leaf;
+    pthread_rwlock_init(&node->latch, NULL);
     return node;
 }
 
-static int find_key_index(BPlusNode *node, const char *key) {
+// Los nodos se crean y liberan siempre con el latch exclusivo
+static void release_node(BPlusTree *tree, BPlusNode *node) {
+    pthread_rwlock_destroy(&node->latch);
+    release_bytes(tree, node->buf, node->capacity);
+    node->next = tree->free_nodes;
+    tree->free_nodes = node;
+}
+
+// Cabeza de ancho fijo: el orden de los enteros coincide con el de memcmp
+// en los 8 primeros bytes, así casi todas las comparaciones evitan el búfer
+static uint64_t load_head(const char *s, size_t len) {
+    uint64_t head = 0;
+    for (size_t i = 0; i < 8; i++) {
+        head <<= 8;
+        if (i < len) head |= (unsigned char)s[i];
+    }
+    return head;
+}
+
+static size_t suffix_len(const BPlusNode *node, int i) {
+    return node->offsets[i + 1] - node->offsets[i];
+}
+
+static const char* suffix_at(const BPlusNode *node, int i) {
+    return node->buf + node->offsets[i];
+}
+
+static size_t key_length(const BPlusNode *node, int i) {
+    return node->prefix_len + suffix_len(node, i);
+}
+
+static void copy_key(const BPlusNode *node, int i, char *out) {
+    size_t len = suffix_len(node, i);
+    memcpy(out, node->buf, node->prefix_len);
+    memcpy(out + node->prefix_len, suffix_at(node, i), len);
+    out[node->prefix_len + len] = '\0';
+}
+
+static char* dup_key(const BPlusNode *node, int i) {
+    char *key = malloc(key_length(node, i) + 1);
+    if (key) copy_key(node, i, key);
+    return key;
+}
+
+// Byte k de la clave i, sin reconstruirla
+static char key_byte(const BPlusNode *node, int i, size_t k) {
+    if (k < node->prefix_len) return node->buf[k];
+    return suffix_at(node, i)[k - node->prefix_len];
+}
+
+static int reserve_keys(BPlusTree *tree, BPlusNode *node, size_t needed) {
+    if (node->buf && needed <= node->capacity) return 0;
+    
+    uint32_t capacity;
+    char *buf = alloc_bytes(tree, needed, &capacity);
+    if (!buf) return -1;
+    
+    if (node->buf) {
+        memcpy(buf, node->buf, node->offsets[node->num_keys]);
+        release_bytes(tree, node->buf, node->capacity);
+    }
+    node->buf = buf;
+    node->capacity = capacity;
+    return 0;
+}
+
+// Clave i de un nodo; una lista de ellas describe las claves de un nodo
+// montado a partir de varios
+typedef struct {
+    const BPlusNode *node;
+    int i;
+} KeyRef;
+
+// Claves ya montadas en su propio búfer. Instalarlas no reserva memoria,
+// así que quien cambia varios nodos prepara todo antes de tocar ninguno
+typedef struct {
+    char *buf;
+    uint32_t capacity;
+    uint32_t prefix_len;
+    int num_keys;
+    uint64_t heads[ORDER];
+    uint32_t offsets[ORDER + 1];
+} KeySet;
+
+// Monta las claves refs (ordenadas) eliminando el prefijo común más largo
+// que no supere max_prefix. No cambia ningún nodo
+static int prepare_keys(BPlusTree *tree, KeySet *set, const KeyRef *refs, int count,
+                        size_t max_prefix) {
+    size_t prefix = 0;
+    if (count > 0) {
+        // Las claves están ordenadas: el prefijo común es el de la primera y la última
+        const KeyRef *first = &refs[0];
+        const KeyRef *last = &refs[count - 1];
+        size_t first_len = key_length(first->node, first->i);
+        size_t last_len = key_length(last->node, last->i);
+        size_t limit = first_len < last_len ? first_len : last_len;
+        if (limit > max_prefix) limit = max_prefix;
+        while (prefix < limit &&
+               key_byte(first->node, first->i, prefix) == key_byte(last->node, last->i, prefix)) {
+            prefix++;
+        }
+    }
+    
+    size_t total = prefix;
+    for (int i = 0; i < count; i++) {
+        total += key_length(refs[i].node, refs[i].i) - prefix;
+    }
+    
+    set->buf = alloc_bytes(tree, total, &set->capacity);
+    if (!set->buf) return -1;
+    
+    size_t pos = 0;
+    if (count > 0) {
+        for (; pos < prefix; pos++) set->buf[pos] = key_byte(refs[0].node, refs[0].i, pos);
+    }
+    for (int i = 0; i < count; i++) {
+        size_t len = key_length(refs[i].node, refs[i].i);
+        set->offsets[i] = pos;
+        for (size_t k = prefix; k < len; k++) {
+            set->buf[pos++] = key_byte(refs[i].node, refs[i].i, k);
+        }
+        set->heads[i] = load_head(set->buf + set->offsets[i], len - prefix);
+    }
+    set->offsets[count] = pos;
+    set->prefix_len = prefix;
+    set->num_keys = count;
+    return 0;
+}
+
+static void install_keys(BPlusTree *tree, BPlusNode *dst, const KeySet *set) {
+    release_bytes(tree, dst->buf, dst->capacity);
+    dst->buf = set->buf;
+    dst->capacity = set->capacity;
+    dst->prefix_len = set->prefix_len;
+    dst->num_keys = set->num_keys;
+    memcpy(dst->heads, set->heads, set->num_keys * sizeof(uint64_t));
+    memcpy(dst->offsets, set->offsets, (set->num_keys + 1) * sizeof(uint32_t));
+}
+
+static void discard_keys(BPlusTree *tree, KeySet *set) {
+    release_bytes(tree, set->buf, set->capacity);
+}
+
+// Rehace las claves de dst con [from, from + count) de src, eliminando el
+// prefijo común más largo que no supere max_prefix. dst puede ser src
+static int build_keys(BPlusTree *tree, BPlusNode *dst, const BPlusNode *src, int from, int count,
+                      size_t max_prefix) {
+    KeyRef refs[ORDER];
+    for (int i = 0; i < count; i++) {
+        refs[i].node = src;
+        refs[i].i = from + i;
+    }
+    
+    KeySet set;
+    if (prepare_keys(tree, &set, refs, count, max_prefix) != 0) return -1;
+    install_keys(tree, dst, &set);
+    return 0;
+}
+
+// Inserta la clave en la posición pos; los punteros los mueve quien llama
+static int node_insert_key(BPlusTree *tree, BPlusNode *node, int pos, const char *key, size_t len) {
+    if (node->num_keys == 0) {
+        // Con una sola clave, toda ella es prefijo común
+        if (reserve_keys(tree, node, len) != 0) return -1;
+        memcpy(node->buf, key, len);
+        node->prefix_len = len;
+        node->offsets[0] = len;
+    } else {
+        size_t common = 0;
+        size_t limit = len < node->prefix_len ? len : node->prefix_len;
+        while (common < limit && key[common] == node->buf[common]) common++;
+        if (common < node->prefix_len &&
+            build_keys(tree, node, node, 0, node->num_keys, common) != 0) {
+            return -1;
+        }
+    }
+    
+    const char *suffix = key + node->prefix_len;
+    size_t slen = len - node->prefix_len;
+    size_t end = node->offsets[node->num_keys];
+    if (reserve_keys(tree, node, end + slen) != 0) return -1;
+    
+    size_t at = node->offsets[pos];
+    memmove(node->buf + at + slen, node->buf + at, end - at);
+    memcpy(node->buf + at, suffix, slen);
+    
+    for (int i = node->num_keys; i >= pos; i--) {
+        node->offsets[i + 1] = node->offsets[i] + slen;
+    }
+    for (int i = node->num_keys; i > pos; i--) {
+        node->heads[i] = node->heads[i - 1];
+    }
+    node->heads[pos] = load_head(suffix, slen);
+    node->num_keys++;
+    return 0;
+}
+
+static void node_remove_key(BPlusNode *node, int pos) {
+    size_t slen = suffix_len(node, pos);
+    size_t end = node->offsets[node->num_keys];
+    size_t next = node->offsets[pos + 1];
+    memmove(node->buf + node->offsets[pos], node->buf + next, end - next);
+    
+    for (int i = pos; i < node->num_keys; i++) {
+        node->offsets[i] = node->offsets[i + 1] - slen;
+    }
+    for (int i = pos; i < node->num_keys - 1; i++) {
+        node->heads[i] = node->heads[i + 1];
+    }
+    node->num_keys--;
+    
+    if (node->num_keys == 0) {
+        node->prefix_len = 0;
+        node->offsets[0] = 0;
+    }
+}
+
+// Compara la clave con el prefijo común del nodo
+static int compare_prefix(const BPlusNode *node, const char *key, size_t len) {
+    size_t n = len < node->prefix_len ? len : node->prefix_len;
+    int c = n ? memcmp(key, node->buf, n) : 0;
+    if (c != 0) return c;
+    return len < node->prefix_len ? -1 : 0;
+}
+
+// Compara un sufijo ya sin prefijo común con el sufijo i: cabezas primero
+static int compare_suffix(const BPlusNode *node, int i, const char *rest,
+                          size_t len, uint64_t head) {
+    if (head != node->heads[i]) return head < node->heads[i] ? -1 : 1;
+    
+    size_t slen = suffix_len(node, i);
+    size_t n = len < slen ? len : slen;
+    if (n > 8) {
+        int c = memcmp(rest + 8, suffix_at(node, i) + 8, n - 8);
+        if (c != 0) return c;
+    }
+    return (len > slen) - (len < slen);
+}
+
+void bplus_tree_set_search_mode(BPlusSearchMode mode) {
+    search_mode = mode;
+}
+
+#if defined(__AVX2__)
+
+const char* bplus_tree_simd_name(void) {
+    return "AVX2";
+}
+
+// Cuenta las cabezas menores e iguales que head, cuatro por iteración.
+// Sin comparación sin signo de 64 bits: se invierte el bit de signo
+static int count_heads(const uint64_t *heads, int n, uint64_t head, int *equal) {
+    const __m256i bias = _mm256_set1_epi64x((long long)0x8000000000000000ULL);
+    const __m256i probe = _mm256_xor_si256(_mm256_set1_epi64x((long long)head), bias);
+    // Las comparaciones dan -1 por carril: restarlas acumula los recuentos
+    __m256i less_acc = _mm256_setzero_si256();
+    __m256i same_acc = _mm256_setzero_si256();
     int i = 0;
-    while (i < node->num_keys && strcmp(key, node->keys[i]) > 0) {
-        i++;
+    for (; i + 4 <= n; i += 4) {
+        __m256i v = _mm256_xor_si256(_mm256_loadu_si256((const __m256i*)(heads + i)), bias);
+        less_acc = _mm256_sub_epi64(less_acc, _mm256_cmpgt_epi64(probe, v));
+        same_acc = _mm256_sub_epi64(same_acc, _mm256_cmpeq_epi64(probe, v));
     }
-    return i;
+    uint64_t lanes[4];
+    _mm256_storeu_si256((__m256i*)lanes, less_acc);
+    int less = (int)(lanes[0] + lanes[1] + lanes[2] + lanes[3]);
+    _mm256_storeu_si256((__m256i*)lanes, same_acc);
+    int same = (int)(lanes[0] + lanes[1] + lanes[2] + lanes[3]);
+    for (; i < n; i++) {
+        less += heads[i] < head;
+        same += heads[i] == head;
+    }
+    *equal = same;
+    return less;
 }
 
-static void insert_into_leaf(BPlusNode *leaf, const char *key, void *value) {
-    int pos = find_key_index(leaf, key);
+#elif defined(__SSE2__)
+
+const char* bplus_tree_simd_name(void) {
+    return "SSE2";
+}
+
+// SSE2 solo compara enteros de 32 bits: cada cabeza se compara por mitades
+// (alta mayor, o alta igual y baja mayor), con sesgo para tratarlas sin signo
+static int count_heads(const uint64_t *heads, int n, uint64_t head, int *equal) {
+    const __m128i bias = _mm_set1_epi32((int)0x80000000u);
+    const __m128i probe = _mm_xor_si128(_mm_set1_epi64x((long long)head), bias);
+    // Las comparaciones dan -1 por carril: restarlas acumula los recuentos
+    __m128i less_acc = _mm_setzero_si128();
+    __m128i same_acc = _mm_setzero_si128();
+    int i = 0;
+    for (; i + 2 <= n; i += 2) {
+        __m128i v = _mm_xor_si128(_mm_loadu_si128((const __m128i*)(heads + i)), bias);
+        __m128i gt = _mm_cmpgt_epi32(probe, v);
+        __m128i eq = _mm_cmpeq_epi32(probe, v);
+        __m128i gt_hi = _mm_shuffle_epi32(gt, _MM_SHUFFLE(3, 3, 1, 1));
+        __m128i gt_lo = _mm_shuffle_epi32(gt, _MM_SHUFFLE(2, 2, 0, 0));
+        __m128i eq_hi = _mm_shuffle_epi32(eq, _MM_SHUFFLE(3, 3, 1, 1));
+        __m128i eq_lo = _mm_shuffle_epi32(eq, _MM_SHUFFLE(2, 2, 0, 0));
+        less_acc = _mm_sub_epi64(less_acc, _mm_or_si128(gt_hi, _mm_and_si128(eq_hi, gt_lo)));
+        same_acc = _mm_sub_epi64(same_acc, _mm_and_si128(eq_hi, eq_lo));
+    }
+    uint64_t lanes[2];
+    _mm_storeu_si128((__m128i*)lanes, less_acc);
+    int less = (int)(lanes[0] + lanes[1]);
+    _mm_storeu_si128((__m128i*)lanes, same_acc);
+    int same = (int)(lanes[0] + lanes[1]);
+    for (; i < n; i++) {
+        less += heads[i] < head;
+        same += heads[i] == head;
+    }
+    *equal = same;
+    return less;
+}
+
+#else
+
+const char* bplus_tree_simd_name(void) {
+    return "escalar";
+}
+
+// Sin vectores: el mismo recuento sin saltos, que el compilador puede vectorizar
+static int count_heads(const uint64_t *heads, int n, uint64_t head, int *equal) {
+    int less = 0;
+    int same = 0;
+    for (int i = 0; i < n; i++) {
+        less += heads[i] < head;
+        same += heads[i] == head;
+    }
+    *equal = same;
+    return less;
+}
+
+#endif
+
+// Primera posición cuya clave no es menor que key (o mayor, con past_equal)
+static int locate(const BPlusNode *node, const char *key, size_t len, int past_equal) {
+    int rel = compare_prefix(node, key, len);
+    if (rel < 0) return 0;
+    if (rel > 0) return node->num_keys;
     
-    for (int i = leaf->num_keys; i > pos; i--) {
-        leaf->keys[i] = leaf->keys[i-1];
-        leaf->pointers[i] = leaf->pointers[i-1];
+    const char *rest = key + node->prefix_len;
+    size_t rest_len = len - node->prefix_len;
+    uint64_t head = load_head(rest, rest_len);
+    
+    int lo = 0;
+    int hi = node->num_keys;
+    switch (search_mode) {
+    case BPLUS_SEARCH_LINEAR:
+        while (lo < hi) {
+            int c = compare_suffix(node, lo, rest, rest_len, head);
+            if (c < 0 || (c == 0 && !past_equal)) break;
+            lo++;
+        }
+        return lo;
+    case BPLUS_SEARCH_SIMD: {
+        // Las cabezas están ordenadas: solo las iguales necesitan mirar bytes
+        int equal;
+        lo = count_heads(node->heads, node->num_keys, head, &equal);
+        hi = lo + equal;
+        if (equal == 0) return lo;
+        break;
+    }
+    case BPLUS_SEARCH_BINARY:
+        break;
     }
     
-    leaf->keys[pos] = strdup(key);
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+        int c = compare_suffix(node, mid, rest, rest_len, head);
+        if (c > 0 || (c == 0 && past_equal)) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+static int find_key_index(BPlusNode *node, const char *key, size_t len) {
+    return locate(node, key, len, 0);
+}
+
+// Hijo a seguir en un nodo interno: las claves iguales al separador
+// viven en el subárbol derecho
+static int find_child_index(BPlusNode *node, const char *key, size_t len) {
+    return locate(node, key, len, 1);
+}
+
+static int key_equals(const BPlusNode *node, int i, const char *key, size_t len) {
+    if (i >= node->num_keys || key_length(node, i) != len) return 0;
+    return memcmp(key, node->buf, node->prefix_len) == 0 &&
+           memcmp(key + node->prefix_len, suffix_at(node, i), suffix_len(node, i)) == 0;
+}
+
+static BPlusNode* find_leaf(BPlusTree *tree, const char *key, size_t len) {
+    BPlusNode *node = tree->root;
+    while (!node->is_leaf) {
+        int i = find_child_index(node, key, len);
+        node = node->pointers[i];
+    }
+    return node;
+}
+
+static int insert_into_leaf(BPlusTree *tree, BPlusNode *leaf, const char *key, size_t len, void *value) {
+    int pos = find_key_index(leaf, key, len);
+    if (node_insert_key(tree, leaf, pos, key, len) != 0) return -1;
+    
+    for (int i = leaf->num_keys - 1; i > pos; i--) {
+        leaf->pointers[i] = leaf->pointers[i-1];
+    }
     leaf->pointers[pos] = value;
-    leaf->num_keys++;
+    return 0;
 }
 
-static BPlusNode* split_leaf(BPlusNode *leaf) {
-    BPlusNode *new_leaf = create_node(1);
+static BPlusNode* split_leaf(BPlusTree *tree, BPlusNode *leaf) {
+    BPlusNode *new_leaf = create_node(tree, 1);
     if (!new_leaf) return NULL;
     
     int split_pos = leaf->num_keys / 2;
+    int moved = leaf->num_keys - split_pos;
+    
+    // Cada mitad recalcula su prefijo común, que suele crecer al partir
+    if (build_keys(tree, new_leaf, leaf, split_pos, moved, SIZE_MAX) != 0 ||
+        build_keys(tree, leaf, leaf, 0, split_pos, SIZE_MAX) != 0) {
+        release_node(tree, new_leaf);
+        return NULL;
+    }
     
-    for (int i = split_pos; i < leaf->num_keys; i++) {
-        new_leaf->keys[i - split_pos] = leaf->keys[i];
-        new_leaf->pointers[i - split_pos] = leaf->pointers[i];
-        leaf->keys[i] = NULL;
-        leaf->pointers[i] = NULL;
+    for (int i = 0; i < moved; i++) {
+        new_leaf->pointers[i] = leaf->pointers[split_pos + i];
+        leaf->pointers[split_pos + i] = NULL;
     }
     
-    leaf->num_keys = split_pos;
-    new_leaf->num_keys = leaf->num_keys - split_pos;
     new_leaf->next = leaf->next;
     leaf->next = new_leaf;
     new_leaf->parent = leaf->parent;
@@ -78,189 +582,726 @@ static BPlusNode* split_leaf(BPlusNode *leaf) {
     return new_leaf;
 }
 
-static void insert_into_parent(BPlusTree *tree, BPlusNode *left, BPlusNode *right, const char *key);
+// Copia de un nodo lleno antes de partirlo, para dejarlo como estaba si
+// falla algo más arriba. Las claves se guardan en un búfer de su misma clase
+typedef struct {
+    int num_keys;
+    uint32_t prefix_len;
+    uint32_t capacity;
+    char *buf;
+    uint64_t heads[ORDER];
+    uint32_t offsets[ORDER + 1];
+    void *pointers[ORDER + 1];
+    BPlusNode *next;
+} NodeBackup;
 
-static BPlusNode* insert_into_node(BPlusTree *tree, BPlusNode *node, int index, 
-                                 const char *key, BPlusNode *right) {
-    for (int i = node->num_keys; i > index; i--) {
-        node->keys[i] = node->keys[i-1];
-        node->pointers[i+1] = node->pointers[i];
+static int backup_node(BPlusTree *tree, const BPlusNode *node, NodeBackup *backup) {
+    uint32_t capacity;
+    backup->buf = alloc_bytes(tree, node->capacity, &capacity);
+    if (!backup->buf) return -1;
+    
+    memcpy(backup->buf, node->buf, node->offsets[node->num_keys]);
+    backup->capacity = capacity;
+    backup->num_keys = node->num_keys;
+    backup->prefix_len = node->prefix_len;
+    memcpy(backup->heads, node->heads, sizeof(node->heads));
+    memcpy(backup->offsets, node->offsets, sizeof(node->offsets));
+    memcpy(backup->pointers, node->pointers, sizeof(node->pointers));
+    backup->next = node->next;
+    return 0;
+}
+
+static void restore_node(BPlusTree *tree, BPlusNode *node, const NodeBackup *backup) {
+    release_bytes(tree, node->buf, node->capacity);
+    node->buf = backup->buf;
+    node->capacity = backup->capacity;
+    node->num_keys = backup->num_keys;
+    node->prefix_len = backup->prefix_len;
+    memcpy(node->heads, backup->heads, sizeof(node->heads));
+    memcpy(node->offsets, backup->offsets, sizeof(node->offsets));
+    memcpy(node->pointers, backup->pointers, sizeof(node->pointers));
+    node->next = backup->next;
+}
+
+static int insert_into_parent(BPlusTree *tree, BPlusNode *left, BPlusNode *right, const char *key);
+
+// Inserta el separador y su hijo derecho, partiendo el nodo si se llena.
+// Si algo falla (aquí o más arriba) el nodo queda como estaba
+static int insert_into_node(BPlusTree *tree, BPlusNode *node, int index, 
+                            const char *key, BPlusNode *right) {
+    NodeBackup backup;
+    int full = node->num_keys >= ORDER - 1;
+    if (full && backup_node(tree, node, &backup) != 0) return -1;
+    
+    // Sin partir, node_insert_key no cambia las claves si falla
+    if (node_insert_key(tree, node, index, key, strlen(key)) != 0) {
+        if (full) restore_node(tree, node, &backup);
+        return -1;
     }
     
-    node->keys[index] = strdup(key);
+    for (int i = node->num_keys; i > index + 1; i--) {
+        node->pointers[i] = node->pointers[i-1];
+    }
     node->pointers[index+1] = right;
-    node->num_keys++;
+    if (!full) return 0;
     
-    if (node->num_keys >= ORDER) {
-        BPlusNode *new_node = create_node(0);
-        if (!new_node) return NULL;
-        
-        int split_pos = node->num_keys / 2;
-        char *split_key = node->keys[split_pos];
-        
-        for (int i = split_pos + 1; i < node->num_keys; i++) {
-            new_node->keys[i - (split_pos + 1)] = node->keys[i];
-            new_node->pointers[i - (split_pos + 1)] = node->pointers[i];
-            ((BPlusNode*)node->pointers[i])->parent = new_node;
-            node->keys[i] = NULL;
-            node->pointers[i] = NULL;
-        }
-        
-        new_node->pointers[node->num_keys - (split_pos + 1)] = node->pointers[node->num_keys];
-        ((BPlusNode*)node->pointers[node->num_keys])->parent = new_node;
-        node->pointers[node->num_keys] = NULL;
-        
-        new_node->num_keys = node->num_keys - (split_pos + 1);
-        node->num_keys = split_pos;
-        new_node->parent = node->parent;
-        
-        if (node == tree->root) {
-            BPlusNode *new_root = create_node(0);
-            if (!new_root) return NULL;
-            
-            new_root->keys[0] = split_key;
-            new_root->pointers[0] = node;
-            new_root->pointers[1] = new_node;
-            new_root->num_keys = 1;
-            node->parent = new_root;
-            new_node->parent = new_root;
-            tree->root = new_root;
-        } else {
-            insert_into_parent(tree, node, new_node, split_key);
+    BPlusNode *new_node = create_node(tree, 0);
+    int split_pos = node->num_keys / 2;
+    int moved = node->num_keys - (split_pos + 1);
+    char *split_key = new_node ? dup_key(node, split_pos) : NULL;
+    if (!split_key ||
+        build_keys(tree, new_node, node, split_pos + 1, moved, SIZE_MAX) != 0 ||
+        build_keys(tree, node, node, 0, split_pos, SIZE_MAX) != 0) {
+        free(split_key);
+        if (new_node) release_node(tree, new_node);
+        restore_node(tree, node, &backup);
+        return -1;
+    }
+    
+    for (int i = 0; i <= moved; i++) {
+        new_node->pointers[i] = node->pointers[split_pos + 1 + i];
+        ((BPlusNode*)new_node->pointers[i])->parent = new_node;
+        node->pointers[split_pos + 1 + i] = NULL;
+    }
+    new_node->parent = node->parent;
+    
+    // El padre (o la nueva raíz) guarda su propia copia del separador
+    int status = insert_into_parent(tree, node, new_node, split_key);
+    free(split_key);
+    if (status != 0) {
+        restore_node(tree, node, &backup);
+        for (int i = 0; i <= node->num_keys; i++) {
+            ((BPlusNode*)node->pointers[i])->parent = node;
         }
+        release_node(tree, new_node);
+        return -1;
     }
     
-    return node;
+    release_bytes(tree, backup.buf, backup.capacity);
+    return 0;
 }
 
-static void insert_into_parent(BPlusTree *tree, BPlusNode *left, BPlusNode *right, const char *key) {
+// Sin cambios si falla
+static int insert_into_parent(BPlusTree *tree, BPlusNode *left, BPlusNode *right, const char *key) {
     BPlusNode *parent = left->parent;
     
     if (!parent) {
-        BPlusNode *new_root = create_node(0);
-        if (!new_root) return;
+        BPlusNode *new_root = create_node(tree, 0);
+        if (!new_root) return -1;
         
-        new_root->keys[0] = strdup(key);
+        if (node_insert_key(tree, new_root, 0, key, strlen(key)) != 0) {
+            release_node(tree, new_root);
+            return -1;
+        }
         new_root->pointers[0] = left;
         new_root->pointers[1] = right;
-        new_root->num_keys = 1;
         left->parent = new_root;
         right->parent = new_root;
         tree->root = new_root;
-        return;
+        return 0;
     }
     
-    int index = find_key_index(parent, key);
-    insert_into_node(tree, parent, index, key, right);
+    int index = find_child_index(parent, key, strlen(key));
+    return insert_into_node(tree, parent, index, key, right);
 }
 
-void bplus_tree_insert(BPlusTree *tree, const char *key, void *value) {
-    if (!tree || !key) return;
-    
+// Todo o nada: ante un fallo de memoria el árbol queda como estaba
+static int insert_exclusive(BPlusTree *tree, const char *key, size_t len, void *value) {
     if (!tree->root) {
-        tree->root = create_node(1);
-        if (!tree->root) return;
+        BPlusNode *root = create_node(tree, 1);
+        if (!root) return -1;
         
-        tree->root->keys[0] = strdup(key);
-        tree->root->pointers[0] = value;
-        tree->root->num_keys = 1;
-        return;
+        if (insert_into_leaf(tree, root, key, len, value) != 0) {
+            release_node(tree, root);
+            return -1;
+        }
+        tree->root = root;
+        return 0;
     }
     
-    BPlusNode *node = tree->root;
-    while (!node->is_leaf) {
-        int i = find_key_index(node, key);
-        node = node->pointers[i];
+    BPlusNode *node = find_leaf(tree, key, len);
+    if (node->num_keys < ORDER - 1) return insert_into_leaf(tree, node, key, len, value);
+    
+    NodeBackup backup;
+    if (backup_node(tree, node, &backup) != 0) return -1;
+    if (insert_into_leaf(tree, node, key, len, value) != 0) {
+        restore_node(tree, node, &backup);
+        return -1;
     }
     
-    insert_into_leaf(node, key, value);
+    BPlusNode *new_leaf = split_leaf(tree, node);
+    char *new_key = new_leaf ? dup_key(new_leaf, 0) : NULL;
+    if (!new_key || insert_into_parent(tree, node, new_leaf, new_key) != 0) {
+        free(new_key);
+        if (new_leaf) release_node(tree, new_leaf);
+        restore_node(tree, node, &backup);
+        return -1;
+    }
     
-    if (node->num_keys >= ORDER) {
-        BPlusNode *new_leaf = split_leaf(node);
-        if (!new_leaf) return;
-        
-        char *new_key = new_leaf->keys[0];
-        insert_into_parent(tree, node, new_leaf, new_key);
+    free(new_key);
+    release_bytes(tree, backup.buf, backup.capacity);
+    return 0;
+}
+
+int bplus_tree_insert(BPlusTree *tree, const char *key, void *value) {
+    if (!tree || !key) return -1;
+    
+    size_t len = strlen(key);
+    if (tree->concurrent) {
+        // Intento optimista: si la hoja tiene hueco no cambia la estructura
+        int done = 0;
+        int status = 0;
+        tree_lock_shared(tree);
+        if (tree->root) {
+            BPlusNode *leaf = find_leaf(tree, key, len);
+            leaf_lock_exclusive(tree, leaf);
+            if (leaf->num_keys < ORDER - 1) {
+                status = insert_into_leaf(tree, leaf, key, len, value);
+                done = 1;
+            }
+            leaf_unlock(tree, leaf);
+        }
+        tree_unlock(tree);
+        if (done) return status;
     }
+    
+    tree_lock_exclusive(tree);
+    int status = insert_exclusive(tree, key, len, value);
+    tree_unlock(tree);
+    return status;
 }
 
-void* bplus_tree_search(BPlusTree *tree, const char *key) {
-    if (!tree || !tree->root || !key) return NULL;
+// Rellena un nodo vacío con claves ya ordenadas
+static int load_keys(BPlusTree *tree, BPlusNode *node, const char *const *keys, int count) {
+    const char *first = keys[0];
+    const char *last = keys[count - 1];
+    size_t prefix = 0;
+    while (first[prefix] && first[prefix] == last[prefix]) prefix++;
     
-    BPlusNode *node = tree->root;
-    while (!node->is_leaf) {
-        int i = find_key_index(node, key);
-        node = node->pointers[i];
+    size_t lens[ORDER];
+    size_t total = prefix;
+    for (int i = 0; i < count; i++) {
+        lens[i] = strlen(keys[i] + prefix);
+        total += lens[i];
     }
     
-    for (int i = 0; i < node->num_keys; i++) {
-        if (strcmp(key, node->keys[i]) == 0) {
-            return node->pointers[i];
+    uint32_t capacity;
+    char *buf = alloc_bytes(tree, total, &capacity);
+    if (!buf) return -1;
+    
+    memcpy(buf, first, prefix);
+    size_t pos = prefix;
+    for (int i = 0; i < count; i++) {
+        size_t len = lens[i];
+        memcpy(buf + pos, keys[i] + prefix, len);
+        node->offsets[i] = pos;
+        node->heads[i] = load_head(buf + pos, len);
+        pos += len;
+    }
+    node->offsets[count] = pos;
+    
+    node->buf = buf;
+    node->capacity = capacity;
+    node->prefix_len = prefix;
+    node->num_keys = count;
+    return 0;
+}
+
+// Reparte total elementos en groups grupos cuyo tamaño difiere como mucho en uno
+static size_t group_size(size_t total, size_t groups, size_t i) {
+    return total / groups + (i < total % groups);
+}
+
+static int bulk_load_exclusive(BPlusTree *tree, const char *const *keys,
+                               void *const *values, size_t n) {
+    if (tree->root || (n > 0 && (!keys || !values))) return -1;
+    for (size_t i = 1; i < n; i++) {
+        if (strcmp(keys[i - 1], keys[i]) >= 0) return -1;
+    }
+    if (n == 0) return 0;
+    
+    // Hojas llenas de ORDER - 1 claves, las últimas igual de llenas que el resto
+    size_t count = (n + ORDER - 2) / (ORDER - 1);
+    BPlusNode **level = malloc(count * sizeof(*level));
+    size_t *lows = malloc(count * sizeof(*lows));    // Menor clave de cada subárbol
+    if (!level || !lows) goto fail;
+    
+    size_t pos = 0;
+    BPlusNode *prev = NULL;
+    for (size_t i = 0; i < count; i++) {
+        size_t take = group_size(n, count, i);
+        BPlusNode *leaf = create_node(tree, 1);
+        if (!leaf || load_keys(tree, leaf, keys + pos, take) != 0) goto fail;
+        memcpy(leaf->pointers, values + pos, take * sizeof(void*));
+        
+        if (prev) prev->next = leaf;
+        prev = leaf;
+        level[i] = leaf;
+        lows[i] = pos;
+        pos += take;
+    }
+    
+    // Cada nivel interno agrupa hasta ORDER hijos; se reescribe en el sitio
+    while (count > 1) {
+        size_t parents = (count + ORDER - 1) / ORDER;
+        size_t child = 0;
+        for (size_t i = 0; i < parents; i++) {
+            size_t take = group_size(count, parents, i);
+            const char *separators[ORDER];
+            for (size_t j = 1; j < take; j++) {
+                separators[j - 1] = keys[lows[child + j]];
+            }
+            
+            BPlusNode *node = create_node(tree, 0);
+            if (!node || load_keys(tree, node, separators, take - 1) != 0) goto fail;
+            for (size_t j = 0; j < take; j++) {
+                node->pointers[j] = level[child + j];
+                level[child + j]->parent = node;
+            }
+            
+            size_t low = lows[child];
+            level[i] = node;
+            lows[i] = low;
+            child += take;
         }
+        count = parents;
     }
     
-    return NULL;
+    tree->root = level[0];
+    free(level);
+    free(lows);
+    return 0;
+    
+fail:
+    // El árbol estaba vacío: basta con devolver toda su memoria
+    free(level);
+    free(lows);
+    free_slabs(tree->node_slabs);
+    free_slabs(tree->byte_slabs);
+    tree->node_slabs = NULL;
+    tree->byte_slabs = NULL;
+    tree->free_nodes = NULL;
+    memset(tree->free_bytes, 0, sizeof(tree->free_bytes));
+    return -1;
 }
 
-static void remove_entry(BPlusNode *node, int index) {
-    free(node->keys[index]);
+int bplus_tree_bulk_load(BPlusTree *tree, const char *const *keys,
+                         void *const *values, size_t n) {
+    if (!tree) return -1;
     
+    tree_lock_exclusive(tree);
+    int status = bulk_load_exclusive(tree, keys, values, n);
+    tree_unlock(tree);
+    return status;
+}
+
+void* bplus_tree_search(BPlusTree *tree, const char *key) {
+    if (!tree || !key) return NULL;
+    
+    void *value = NULL;
+    tree_lock_shared(tree);
+    if (tree->root) {
+        size_t len = strlen(key);
+        BPlusNode *node = find_leaf(tree, key, len);
+        
+        leaf_lock_shared(tree, node);
+        int i = find_key_index(node, key, len);
+        if (key_equals(node, i, key, len)) value = node->pointers[i];
+        leaf_unlock(tree, node);
+    }
+    tree_unlock(tree);
+    return value;
+}
+
+static void remove_entry(BPlusNode *node, int index) {
     if (node->is_leaf) {
         for (int i = index; i < node->num_keys - 1; i++) {
-            node->keys[i] = node->keys[i+1];
             node->pointers[i] = node->pointers[i+1];
         }
     } else {
         for (int i = index; i < node->num_keys - 1; i++) {
-            node->keys[i] = node->keys[i+1];
             node->pointers[i+1] = node->pointers[i+2];
         }
     }
     
-    node->num_keys--;
+    node_remove_key(node, index);
 }
 
-int bplus_tree_delete(BPlusTree *tree, const char *key) {
-    if (!tree || !tree->root || !key) return -1;
+// Añade a refs, desde count, las claves de node salvo skip (-1: ninguna)
+static int collect_keys(const BPlusNode *node, int skip, KeyRef *refs, int count) {
+    for (int i = 0; i < node->num_keys; i++) {
+        if (i == skip) continue;
+        refs[count].node = node;
+        refs[count].i = i;
+        count++;
+    }
+    return count;
+}
+
+// Añade a out, desde count, los punteros de node salvo el de la entrada skip
+// (-1: ninguna): en una hoja su valor, en un nodo interno el hijo a su derecha
+static int collect_pointers(const BPlusNode *node, int skip, void **out, int count) {
+    int total = node->num_keys + (node->is_leaf ? 0 : 1);
+    int drop = skip < 0 ? -1 : (node->is_leaf ? skip : skip + 1);
+    for (int i = 0; i < total; i++) {
+        if (i != drop) out[count++] = node->pointers[i];
+    }
+    return count;
+}
+
+// Claves del padre con el separador sep sustituido por la clave i de src
+static int prepare_separator(BPlusTree *tree, KeySet *set, const BPlusNode *parent, int sep,
+                             const BPlusNode *src, int i) {
+    KeyRef refs[ORDER];
+    int count = collect_keys(parent, -1, refs, 0);
+    refs[sep].node = src;
+    refs[sep].i = i;
+    return prepare_keys(tree, set, refs, count, SIZE_MAX);
+}
+
+static int child_position(const BPlusNode *parent, const BPlusNode *child) {
+    for (int i = 0; i <= parent->num_keys; i++) {
+        if (parent->pointers[i] == child) return i;
+    }
+    return -1;
+}
+
+// Pasa la última entrada del hermano izquierdo al principio del nodo, que
+// pierde la entrada index. En nodos internos el separador baja y la clave
+// del hermano sube; en hojas la clave prestada es el nuevo separador
+static int borrow_from_left(BPlusTree *tree, BPlusNode *node, int index, BPlusNode *left,
+                            BPlusNode *parent, int sep) {
+    int last = left->num_keys - 1;
+    KeyRef refs[ORDER];
+    refs[0].node = node->is_leaf ? left : parent;
+    refs[0].i = node->is_leaf ? last : sep;
+    int count = collect_keys(node, index, refs, 1);
     
-    BPlusNode *node = tree->root;
-    while (!node->is_leaf) {
-        int i = find_key_index(node, key);
-        node = node->pointers[i];
+    KeySet keys;
+    KeySet separators;
+    if (prepare_keys(tree, &keys, refs, count, SIZE_MAX) != 0) return -1;
+    if (prepare_separator(tree, &separators, parent, sep, left, last) != 0) {
+        discard_keys(tree, &keys);
+        return -1;
     }
     
-    int index = -1;
-    for (int i = 0; i < node->num_keys; i++) {
-        if (strcmp(key, node->keys[i]) == 0) {
-            index = i;
-            break;
-        }
+    void *pointers[ORDER + 1];
+    pointers[0] = left->pointers[node->is_leaf ? last : last + 1];
+    int moved = collect_pointers(node, index, pointers, 1);
+    memcpy(node->pointers, pointers, moved * sizeof(void*));
+    if (!node->is_leaf) ((BPlusNode*)node->pointers[0])->parent = node;
+    
+    install_keys(tree, node, &keys);
+    install_keys(tree, parent, &separators);
+    node_remove_key(left, last);
+    return 0;
+}
+
+// Pasa la primera entrada del hermano derecho al final del nodo, que pierde
+// la entrada index. En hojas el separador pasa a ser la segunda clave del
+// hermano, que queda como primera
+static int borrow_from_right(BPlusTree *tree, BPlusNode *node, int index, BPlusNode *right,
+                             BPlusNode *parent, int sep) {
+    KeyRef refs[ORDER];
+    int count = collect_keys(node, index, refs, 0);
+    refs[count].node = node->is_leaf ? right : parent;
+    refs[count].i = node->is_leaf ? 0 : sep;
+    count++;
+    
+    KeySet keys;
+    KeySet separators;
+    if (prepare_keys(tree, &keys, refs, count, SIZE_MAX) != 0) return -1;
+    if (prepare_separator(tree, &separators, parent, sep, right, node->is_leaf ? 1 : 0) != 0) {
+        discard_keys(tree, &keys);
+        return -1;
     }
     
-    if (index == -1) return -1;
+    void *pointers[ORDER + 1];
+    int moved = collect_pointers(node, index, pointers, 0);
+    pointers[moved++] = right->pointers[0];
+    memcpy(node->pointers, pointers, moved * sizeof(void*));
+    if (!node->is_leaf) ((BPlusNode*)node->pointers[moved - 1])->parent = node;
     
-    remove_entry(node, index);
+    int total = right->num_keys + (right->is_leaf ? 0 : 1);
+    memmove(right->pointers, right->pointers + 1, (total - 1) * sizeof(void*));
+    install_keys(tree, node, &keys);
+    install_keys(tree, parent, &separators);
+    node_remove_key(right, 0);
     return 0;
 }
 
+static int delete_entry(BPlusTree *tree, BPlusNode *node, int index);
+
+// Funde right en left; node (uno de los dos) pierde la entrada index y el
+// padre el separador sep y el puntero a right. Las claves fundidas se montan
+// en una pasada antes de tocar nada y solo se instalan si el padre también
+// pudo quitar su entrada
+static int merge_nodes(BPlusTree *tree, BPlusNode *left, BPlusNode *right, BPlusNode *node,
+                       int index, BPlusNode *parent, int sep) {
+    int left_skip = left == node ? index : -1;
+    int right_skip = right == node ? index : -1;
+    
+    KeyRef refs[ORDER];
+    int count = collect_keys(left, left_skip, refs, 0);
+    if (!left->is_leaf) {
+        refs[count].node = parent;
+        refs[count].i = sep;
+        count++;
+    }
+    count = collect_keys(right, right_skip, refs, count);
+    
+    KeySet keys;
+    if (prepare_keys(tree, &keys, refs, count, SIZE_MAX) != 0) return -1;
+    if (delete_entry(tree, parent, sep) != 0) {
+        discard_keys(tree, &keys);
+        return -1;
+    }
+    
+    void *pointers[ORDER + 1];
+    int moved = collect_pointers(left, left_skip, pointers, 0);
+    moved = collect_pointers(right, right_skip, pointers, moved);
+    memcpy(left->pointers, pointers, moved * sizeof(void*));
+    if (left->is_leaf) {
+        left->next = right->next;
+    } else {
+        for (int i = 0; i < moved; i++) {
+            ((BPlusNode*)left->pointers[i])->parent = left;
+        }
+    }
+    
+    install_keys(tree, left, &keys);
+    release_node(tree, right);
+    return 0;
+}
+
+// Quita la entrada index (en nodos internos, la clave y el hijo a su derecha)
+// y reequilibra: pedir prestado a un hermano, fusionarse con él o, en la
+// raíz, eliminar el nivel sobrante. Todo o nada: si falta memoria en este
+// nivel o en alguno de arriba, el árbol queda como estaba
+static int delete_entry(BPlusTree *tree, BPlusNode *node, int index) {
+    if (node == tree->root) {
+        remove_entry(node, index);
+        if (node->num_keys > 0) return 0;
+        if (node->is_leaf) {
+            tree->root = NULL;
+        } else {
+            tree->root = node->pointers[0];
+            tree->root->parent = NULL;
+        }
+        release_node(tree, node);
+        return 0;
+    }
+    
+    if (node->num_keys > MIN_KEYS) {
+        remove_entry(node, index);
+        return 0;
+    }
+    
+    BPlusNode *parent = node->parent;
+    int pos = child_position(parent, node);
+    BPlusNode *left = pos > 0 ? parent->pointers[pos - 1] : NULL;
+    BPlusNode *right = pos < parent->num_keys ? parent->pointers[pos + 1] : NULL;
+    
+    if (left && left->num_keys > MIN_KEYS) {
+        return borrow_from_left(tree, node, index, left, parent, pos - 1);
+    }
+    if (right && right->num_keys > MIN_KEYS) {
+        return borrow_from_right(tree, node, index, right, parent, pos);
+    }
+    if (left) return merge_nodes(tree, left, node, node, index, parent, pos - 1);
+    return merge_nodes(tree, node, right, node, index, parent, pos);
+}
+
+static int delete_exclusive(BPlusTree *tree, const char *key, size_t len) {
+    if (!tree->root) return -1;
+    
+    BPlusNode *node = find_leaf(tree, key, len);
+    int index = find_key_index(node, key, len);
+    if (!key_equals(node, index, key, len)) return -1;
+    
+    return delete_entry(tree, node, index);
+}
+
+int bplus_tree_delete(BPlusTree *tree, const char *key) {
+    if (!tree || !key) return -1;
+    
+    size_t len = strlen(key);
+    if (tree->concurrent) {
+        // Intento optimista: basta la hoja si no queda por debajo del mínimo
+        int status = 1;
+        tree_lock_shared(tree);
+        if (tree->root) {
+            BPlusNode *leaf = find_leaf(tree, key, len);
+            leaf_lock_exclusive(tree, leaf);
+            int index = find_key_index(leaf, key, len);
+            int min = leaf == tree->root ? 1 : MIN_KEYS;
+            if (!key_equals(leaf, index, key, len)) {
+                status = -1;
+            } else if (leaf->num_keys > min) {
+                remove_entry(leaf, index);
+                status = 0;
+            }
+            leaf_unlock(tree, leaf);
+        } else {
+            status = -1;
+        }
+        tree_unlock(tree);
+        if (status != 1) return status;
+    }
+    
+    tree_lock_exclusive(tree);
+    int status = delete_exclusive(tree, key, len);
+    tree_unlock(tree);
+    return status;
+}
+
 void bplus_tree_free(BPlusTree *tree) {
     if (!tree) return;
-    free_node_recursive(tree->root);
+    // Los cerrojos de los nodos vivos no retienen recursos: basta con los slabs
+    pthread_rwlock_destroy(&tree->latch);
+    pthread_mutex_destroy(&tree->alloc_lock);
+    free_slabs(tree->node_slabs);
+    free_slabs(tree->byte_slabs);
     free(tree);
 }
 
-void bplus_tree_list(BPlusTree *tree, void (*callback)(const char *key, void *value)) {
-    if (!tree || !tree->root || !callback) return;
-    
+// Reconstruye la clave i en un búfer reutilizable entre llamadas
+static const char* scratch_key(const BPlusNode *node, int i, char **scratch, size_t *size) {
+    size_t needed = key_length(node, i) + 1;
+    if (needed > *size) {
+        char *buf = realloc(*scratch, needed);
+        if (!buf) return NULL;
+        *scratch = buf;
+        *size = needed;
+    }
+    copy_key(node, i, *scratch);
+    return *scratch;
+}
+
+static BPlusNode* first_leaf(BPlusTree *tree) {
     BPlusNode *node = tree->root;
     while (!node->is_leaf) {
         node = node->pointers[0];
     }
+    return node;
+}
+
+void bplus_tree_list(BPlusTree *tree, void (*callback)(const char *key, void *value)) {
+    if (!tree || !callback) return;
     
+    tree_lock_shared(tree);
+    BPlusNode *node = tree->root ? first_leaf(tree) : NULL;
+    char *scratch = NULL;
+    size_t size = 0;
     while (node) {
+        leaf_lock_shared(tree, node);
         for (int i = 0; i < node->num_keys; i++) {
-            callback(node->keys[i], node->pointers[i]);
+            const char *key = scratch_key(node, i, &scratch, &size);
+            if (key) callback(key, node->pointers[i]);
         }
+        leaf_unlock(tree, node);
         node = node->next;
     }
-}
\ No newline at end of file
+    tree_unlock(tree);
+    free(scratch);
+}
+
+void bplus_tree_foreach(BPlusTree *tree,
+                        void (*callback)(const char *key, void *value, void *ctx),
+                        void *ctx) {
+    if (!tree || !callback) return;
+    
+    tree_lock_shared(tree);
+    BPlusNode *node = tree->root ? first_leaf(tree) : NULL;
+    char *scratch = NULL;
+    size_t size = 0;
+    while (node) {
+        leaf_lock_shared(tree, node);
+        for (int i = 0; i < node->num_keys; i++) {
+            const char *key = scratch_key(node, i, &scratch, &size);
+            if (key) callback(key, node->pointers[i], ctx);
+        }
+        leaf_unlock(tree, node);
+        node = node->next;
+    }
+    tree_unlock(tree);
+    free(scratch);
+}
+
+int bplus_tree_range(BPlusTree *tree, const char *lo, const char *hi,
+                     void (*callback)(const char *key, void *value, void *ctx),
+                     void *ctx) {
+    if (!tree || !callback) return 0;
+    
+    tree_lock_shared(tree);
+    BPlusNode *node = NULL;
+    size_t lo_len = lo ? strlen(lo) : 0;
+    if (tree->root) {
+        node = lo ? find_leaf(tree, lo, lo_len) : first_leaf(tree);
+    }
+    
+    size_t hi_len = hi ? strlen(hi) : 0;
+    char *scratch = NULL;
+    size_t size = 0;
+    int visited = 0;
+    for (int first = 1; node; node = node->next, first = 0) {
+        leaf_lock_shared(tree, node);
+        int i = first && lo ? find_key_index(node, lo, lo_len) : 0;
+        // Claves de la hoja menores que hi: la búsqueda del nodo da el corte
+        int end = hi ? find_key_index(node, hi, hi_len) : node->num_keys;
+        for (; i < end; i++) {
+            const char *key = scratch_key(node, i, &scratch, &size);
+            if (key) callback(key, node->pointers[i], ctx);
+            visited++;
+        }
+        int last = end < node->num_keys;
+        leaf_unlock(tree, node);
+        if (last) break;
+    }
+    tree_unlock(tree);
+    free(scratch);
+    return visited;
+}
+
+static int key_has_prefix(const BPlusNode *node, int i, const char *prefix, size_t len) {
+    if (key_length(node, i) < len) return 0;
+    
+    size_t shared = len < node->prefix_len ? len : node->prefix_len;
+    return memcmp(node->buf, prefix, shared) == 0 &&
+           memcmp(suffix_at(node, i), prefix + shared, len - shared) == 0;
+}
+
+int bplus_tree_prefix(BPlusTree *tree, const char *prefix,
+                      void (*callback)(const char *key, void *value, void *ctx),
+                      void *ctx) {
+    if (!tree || !prefix || !callback) return 0;
+    
+    tree_lock_shared(tree);
+    size_t len = strlen(prefix);
+    BPlusNode *node = tree->root ? find_leaf(tree, prefix, len) : NULL;
+    
+    char *scratch = NULL;
+    size_t size = 0;
+    int visited = 0;
+    for (int first = 1; node; node = node->next, first = 0) {
+        leaf_lock_shared(tree, node);
+        int i = first ? find_key_index(node, prefix, len) : 0;
+        // Si el prefijo común del nodo ya empieza por prefix, coinciden todas
+        int whole = node->prefix_len >= len && memcmp(node->buf, prefix, len) == 0;
+        int stop = 0;
+        for (; i < node->num_keys; i++) {
+            if (!whole && !key_has_prefix(node, i, prefix, len)) {
+                stop = 1;
+                break;
+            }
+            const char *key = scratch_key(node, i, &scratch, &size);
+            if (key) callback(key, node->pointers[i], ctx);
+            visited++;
+        }
+        leaf_unlock(tree, node);
+        if (stop) break;
+    }
+    tree_unlock(tree);
+    free(scratch);
+    return visited;
+}
@@ -6,28 +6,116 @@
 #include <stddef.h>
 #include <stdlib.h>
 #include <string.h>
+#include <pthread.h>
 
-#define ORDER 4
-#define MIN_KEYS (ORDER / 2)
+// Orden del árbol, ajustable al compilar (-DBPLUS_ORDER=n). Por defecto un
+// nodo ronda los 3 KB, así que 10.000 claves caben en 2-3 niveles
+#ifndef BPLUS_ORDER
+#define BPLUS_ORDER 128
+#endif
 
+#if BPLUS_ORDER < 4
+#error "BPLUS_ORDER debe ser al menos 4"
+#endif
+
+#define ORDER BPLUS_ORDER
+// Un nodo admite ORDER - 1 claves; con este mínimo dos hermanos escasos
+// siempre caben en uno al fusionarse (también con el separador del padre)
+#define MIN_KEYS ((ORDER - 1) / 2)
+
+// Tamaño inicial del búfer de claves de un nodo
+#define BPLUS_KEY_BUFFER 256
+
+// Las claves de un nodo viven en un único búfer: prefijo común | sufijo 0 |
+// sufijo 1 | ... El sufijo i ocupa [offsets[i], offsets[i + 1])
 typedef struct BPlusNode {
     int is_leaf;
     int num_keys;
-    char *keys[ORDER];
+    uint32_t prefix_len;
+    uint32_t capacity;
+    char *buf;
+    uint64_t heads[ORDER];      // Primeros 8 bytes de cada sufijo, big-endian
+    uint32_t offsets[ORDER + 1];
     void *pointers[ORDER + 1];
+    pthread_rwlock_t latch;     // Solo se usa en las hojas, en modo concurrente
     struct BPlusNode *parent;
     struct BPlusNode *next;
 } BPlusNode;
 
+// Nodos por slab y tamaño de los slabs de claves
+#define BPLUS_SLAB_NODES 64
+#define BPLUS_BYTE_SLAB (1 << 20)
+#define BPLUS_KEY_CLASSES 20    // Búferes de claves de 256 B a 128 MB
+
+// Bloque de memoria del que se reparten nodos o búferes de claves
+typedef struct BPlusSlab {
+    struct BPlusSlab *next;
+    size_t size;
+    size_t used;
+    unsigned char data[];
+} BPlusSlab;
+
+// El árbol es dueño de toda su memoria: liberar es recorrer los slabs.
+// En modo concurrente, lecturas y cambios que no salen de una hoja toman
+// latch compartido más el cerrojo de la hoja; partir, fusionar o redistribuir
+// reintenta con latch exclusivo
 typedef struct {
     BPlusNode *root;
+    int concurrent;
+    pthread_rwlock_t latch;
+    pthread_mutex_t alloc_lock;             // Slabs y listas libres compartidas
+    BPlusSlab *node_slabs;
+    BPlusSlab *byte_slabs;
+    BPlusNode *free_nodes;                  // Enlazados por next
+    char *free_bytes[BPLUS_KEY_CLASSES];    // Uno por clase de tamaño
 } BPlusTree;
 
+// Estrategia de búsqueda dentro de un nodo
+typedef enum {
+    BPLUS_SEARCH_LINEAR,    // Recorrido secuencial
+    BPLUS_SEARCH_BINARY,    // Búsqueda binaria sobre los sufijos
+    BPLUS_SEARCH_SIMD       // Cabezas comparadas en bloque, binaria entre iguales
+} BPlusSearchMode;
+
+// La emulación SSE2 de la comparación de 64 bits no compensa a la binaria
+#ifdef __AVX2__
+#define BPLUS_SEARCH_DEFAULT BPLUS_SEARCH_SIMD
+#else
+#define BPLUS_SEARCH_DEFAULT BPLUS_SEARCH_BINARY
+#endif
+
 BPlusTree* bplus_tree_init();
 void bplus_tree_free(BPlusTree *tree);
-void bplus_tree_insert(BPlusTree *tree, const char *key, void *value);
+// -1 si falta memoria; el árbol queda entonces sin cambios
+int bplus_tree_insert(BPlusTree *tree, const char *key, void *value);
+// Construye un árbol vacío a partir de claves estrictamente ordenadas
+int bplus_tree_bulk_load(BPlusTree *tree, const char *const *keys,
+                         void *const *values, size_t n);
 void* bplus_tree_search(BPlusTree *tree, const char *key);
+// -1 si la clave no está o falta memoria para reequilibrar; el árbol queda
+// entonces sin cambios
 int bplus_tree_delete(BPlusTree *tree, const char *key);
+// La clave que recibe el callback solo es válida durante la llamada, y el
+// callback no debe modificar el árbol que se está recorriendo
 void bplus_tree_list(BPlusTree *tree, void (*callback)(const char *key, void *value));
+void bplus_tree_foreach(BPlusTree *tree,
+                        void (*callback)(const char *key, void *value, void *ctx),
+                        void *ctx);
+
+// Recorren solo las hojas del resultado: claves en [lo, hi) (NULL = sin
+// límite) o que empiezan por prefix. Devuelven cuántas se visitaron
+int bplus_tree_range(BPlusTree *tree, const char *lo, const char *hi,
+                     void (*callback)(const char *key, void *value, void *ctx),
+                     void *ctx);
+int bplus_tree_prefix(BPlusTree *tree, const char *prefix,
+                      void (*callback)(const char *key, void *value, void *ctx),
+                      void *ctx);
+
+// Activar antes de compartir el árbol entre hilos
+void bplus_tree_set_concurrent(BPlusTree *tree, int enabled);
+
+// Afecta a todos los árboles; pensado para pruebas de rendimiento
+void bplus_tree_set_search_mode(BPlusSearchMode mode);
+const char* bplus_tree_simd_name(void);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,75 @@
+
+#define _POSIX_C_SOURCE 200809L
+#include "workqueue.h"
+#include <stdlib.h>
+
+int workqueue_init(WorkQueue *queue, size_t capacity) {
+    if (!queue || capacity == 0) return -1;
+
+    queue->items = calloc(capacity, sizeof(void*));
+    if (!queue->items) return -1;
+
+    queue->capacity = capacity;
+    queue->head = 0;
+    queue->count = 0;
+    queue->closed = 0;
+    pthread_mutex_init(&queue->lock, NULL);
+    pthread_cond_init(&queue->not_empty, NULL);
+    pthread_cond_init(&queue->not_full, NULL);
+    return 0;
+}
+
+void workqueue_destroy(WorkQueue *queue) {
+    if (!queue) return;
+    pthread_mutex_destroy(&queue->lock);
+    pthread_cond_destroy(&queue->not_empty);
+    pthread_cond_destroy(&queue->not_full);
+    free(queue->items);
+    queue->items = NULL;
+}
+
+// Bloquea mientras la cola esté llena; falla si ya se cerró
+int workqueue_push(WorkQueue *queue, void *item) {
+    pthread_mutex_lock(&queue->lock);
+    while (queue->count == queue->capacity && !queue->closed) {
+        pthread_cond_wait(&queue->not_full, &queue->lock);
+    }
+    if (queue->closed) {
+        pthread_mutex_unlock(&queue->lock);
+        return -1;
+    }
+
+    queue->items[(queue->head + queue->count) % queue->capacity] = item;
+    queue->count++;
+    pthread_cond_signal(&queue->not_empty);
+    pthread_mutex_unlock(&queue->lock);
+    return 0;
+}
+
+// Devuelve NULL cuando la cola está cerrada y vacía
+void* workqueue_pop(WorkQueue *queue) {
+    pthread_mutex_lock(&queue->lock);
+    while (queue->count == 0 && !queue->closed) {
+        pthread_cond_wait(&queue->not_empty, &queue->lock);
+    }
+    if (queue->count == 0) {
+        pthread_mutex_unlock(&queue->lock);
+        return NULL;
+    }
+
+    void *item = queue->items[queue->head];
+    queue->head = (queue->head + 1) % queue->capacity;
+    queue->count--;
+    pthread_cond_signal(&queue->not_full);
+    pthread_mutex_unlock(&queue->lock);
+    return item;
+}
+
+// Los consumidores vacían lo pendiente y después reciben NULL
+void workqueue_close(WorkQueue *queue) {
+    pthread_mutex_lock(&queue->lock);
+    queue->closed = 1;
+    pthread_cond_broadcast(&queue->not_empty);
+    pthread_cond_broadcast(&queue->not_full);
+    pthread_mutex_unlock(&queue->lock);
+}
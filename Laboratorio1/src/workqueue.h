@@ -0,0 +1,26 @@
+
+#ifndef WORKQUEUE_H
+#define WORKQUEUE_H
+
+#include <stddef.h>
+#include <pthread.h>
+
+// Cola acotada y bloqueante para pasar trabajos entre hilos
+typedef struct {
+    void **items;
+    size_t capacity;
+    size_t head;
+    size_t count;
+    int closed;
+    pthread_mutex_t lock;
+    pthread_cond_t not_empty;
+    pthread_cond_t not_full;
+} WorkQueue;
+
+int workqueue_init(WorkQueue *queue, size_t capacity);
+void workqueue_destroy(WorkQueue *queue);
+int workqueue_push(WorkQueue *queue, void *item);
+void* workqueue_pop(WorkQueue *queue);
+void workqueue_close(WorkQueue *queue);
+
+#endif
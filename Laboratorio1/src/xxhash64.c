@@ -0,0 +1,124 @@
+
+#define _POSIX_C_SOURCE 200809L
+#include "xxhash64.h"
+#include <string.h>
+
+#define PRIME1 11400714785074694791ULL
+#define PRIME2 14029467366897019727ULL
+#define PRIME3 1609587929392839161ULL
+#define PRIME4 9650029242287828579ULL
+#define PRIME5 2870177450012600261ULL
+
+static uint64_t rotl(uint64_t x, int r) {
+    return (x << r) | (x >> (64 - r));
+}
+
+// Lecturas en orden little-endian, como el resto de formatos en disco
+static uint64_t read64(const uint8_t *p) {
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static uint32_t read32(const uint8_t *p) {
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static uint64_t round64(uint64_t acc, uint64_t input) {
+    acc += input * PRIME2;
+    acc = rotl(acc, 31);
+    return acc * PRIME1;
+}
+
+static uint64_t merge_round(uint64_t acc, uint64_t val) {
+    acc ^= round64(0, val);
+    return acc * PRIME1 + PRIME4;
+}
+
+void xxh64_init(XXH64State *state, uint64_t seed) {
+    memset(state, 0, sizeof(*state));
+    state->seed = seed;
+    state->v[0] = seed + PRIME1 + PRIME2;
+    state->v[1] = seed + PRIME2;
+    state->v[2] = seed;
+    state->v[3] = seed - PRIME1;
+}
+
+static void consume_stripe(XXH64State *state, const uint8_t *p) {
+    state->v[0] = round64(state->v[0], read64(p));
+    state->v[1] = round64(state->v[1], read64(p + 8));
+    state->v[2] = round64(state->v[2], read64(p + 16));
+    state->v[3] = round64(state->v[3], read64(p + 24));
+}
+
+void xxh64_update(XXH64State *state, const void *data, size_t size) {
+    const uint8_t *p = data;
+    state->total_len += size;
+
+    // Completar la franja de 32 bytes que quedó a medias
+    if (state->buffered > 0) {
+        size_t take = sizeof(state->buffer) - state->buffered;
+        if (take > size) take = size;
+        memcpy(state->buffer + state->buffered, p, take);
+        state->buffered += take;
+        p += take;
+        size -= take;
+        if (state->buffered < sizeof(state->buffer)) return;
+        consume_stripe(state, state->buffer);
+        state->buffered = 0;
+    }
+
+    for (; size >= 32; p += 32, size -= 32) {
+        consume_stripe(state, p);
+    }
+
+    memcpy(state->buffer, p, size);
+    state->buffered = size;
+}
+
+uint64_t xxh64_digest(const XXH64State *state) {
+    uint64_t h;
+    if (state->total_len >= 32) {
+        h = rotl(state->v[0], 1) + rotl(state->v[1], 7) +
+            rotl(state->v[2], 12) + rotl(state->v[3], 18);
+        for (int i = 0; i < 4; i++) {
+            h = merge_round(h, state->v[i]);
+        }
+    } else {
+        h = state->seed + PRIME5;
+    }
+    h += state->total_len;
+
+    const uint8_t *p = state->buffer;
+    size_t size = state->buffered;
+    for (; size >= 8; p += 8, size -= 8) {
+        h ^= round64(0, read64(p));
+        h = rotl(h, 27) * PRIME1 + PRIME4;
+    }
+    if (size >= 4) {
+        h ^= (uint64_t)read32(p) * PRIME1;
+        h = rotl(h, 23) * PRIME2 + PRIME3;
+        p += 4;
+        size -= 4;
+    }
+    for (; size > 0; p++, size--) {
+        h ^= *p * PRIME5;
+        h = rotl(h, 11) * PRIME1;
+    }
+
+    h ^= h >> 33;
+    h *= PRIME2;
+    h ^= h >> 29;
+    h *= PRIME3;
+    h ^= h >> 32;
+    return h;
+}
+
+uint64_t xxh64(const void *data, size_t size, uint64_t seed) {
+    XXH64State state;
+    xxh64_init(&state, seed);
+    xxh64_update(&state, data, size);
+    return xxh64_digest(&state);
+}
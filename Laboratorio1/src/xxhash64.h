@@ -0,0 +1,23 @@
+
+#ifndef XXHASH64_H
+#define XXHASH64_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// XXH64 (algoritmo público de xxHash), en streaming: sirve de hash de
+// contenido para deduplicar archivos mientras se leen
+typedef struct {
+    uint64_t total_len;
+    uint64_t v[4];
+    uint8_t buffer[32];
+    size_t buffered;
+    uint64_t seed;
+} XXH64State;
+
+void xxh64_init(XXH64State *state, uint64_t seed);
+void xxh64_update(XXH64State *state, const void *data, size_t size);
+uint64_t xxh64_digest(const XXH64State *state);
+uint64_t xxh64(const void *data, size_t size, uint64_t seed);
+
+#endif